@@ -0,0 +1,480 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MARTOS_LIST_H
+#define MARTOS_LIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** \file
+
+The list primitives are static inline so that they can be
+expanded in kernel hot paths. list_enqueue(), list_find() and
+plist_add() contain loops and are kept out of line in
+src/list.c.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int16_t Node_Prio;
+static const Node_Prio NODE_PRIO_MIN = INT16_MIN;
+static const Node_Prio NODE_PRIO_MAX = INT16_MAX;
+
+
+typedef struct Node_ {
+    struct Node_ *next;
+    struct Node_ *prev;
+    /* name may be NULL, but then it can't be found by
+    list_find() and similar functions. */
+    char *name;
+    Node_Prio prio;
+} Node;
+
+
+typedef struct MinNode_ {
+    struct MinNode_ *next;
+    struct MinNode_ *prev;
+} MinNode;
+
+
+/**
+\brief Datatype for a list, double-ended queue and priority
+queue.
+
+List is implemented with a doubly linked list.
+*/
+
+typedef struct {
+    MinNode head;
+    MinNode tail;
+} List;
+
+
+/**
+\brief Static initializer for a List.
+
+\param list The list object being initialized.
+*/
+#define LIST_INIT(list) { \
+    {(MinNode *) &(list).tail, NULL}, \
+    {NULL, (MinNode *) &(list).head} \
+}
+
+
+/**
+\brief Get the structure which contains a list node.
+
+A compiler diagnostic is given if ptr does not have the type of
+a pointer to member.
+
+\param ptr Pointer to the node.
+\param type Type of the containing structure.
+\param member Name of the node member in type.
+*/
+#define LIST_CONTAINER(ptr, type, member) \
+    ((type *) ((uint8_t *) (1 ? (ptr) : &((type *) 0)->member) - \
+      offsetof(type, member)))
+
+
+/**
+\brief Iterate over all nodes of a list.
+
+The current node must not be unlinked by the loop body. Use
+LIST_FOR_EACH_SAFE() for that.
+
+\param node Node or MinNode pointer used as loop cursor.
+\param list The list to iterate over.
+*/
+#define LIST_FOR_EACH(node, list) \
+    for ((node) = (void *) (list)->head.next; \
+      NULL != (node)->next; \
+      (node) = (void *) (node)->next)
+
+
+/**
+\brief Iterate over all nodes of a list, allowing unlink.
+
+\param node Node or MinNode pointer used as loop cursor.
+\param next Pointer of same type as node, used for temporary
+storage.
+\param list The list to iterate over.
+*/
+#define LIST_FOR_EACH_SAFE(node, next, list) \
+    for ((node) = (void *) (list)->head.next; \
+      NULL != ((next) = (void *) (node)->next); \
+      (node) = (next))
+
+
+/**
+\brief Unlink node from list.
+
+The modified list is implicit.
+
+\param node The node to unlink.
+*/
+static inline void list_unlink(Node *const node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+}
+
+
+/**
+\brief Prepare a list for list operations.
+
+This function must be applied to the list before any other
+list operation can take place.
+
+\param list The list to initialize.
+*/
+static inline void list_init(List *const list)
+{
+    list->head.next = &(list->tail);
+    list->head.prev = NULL;
+    list->tail.next = NULL;
+    list->tail.prev = &(list->head);
+}
+
+
+/**
+\brief Test if list is empty.
+
+\param list The list to check for emptiness.
+\return true if list is empty, false otherwise.
+*/
+static inline bool list_is_empty(List *const list)
+{
+    return &list->head == list->tail.prev;
+}
+
+
+/**
+\brief Insert a node before another node.
+
+\param next Insert node before this node. It may be the tail
+of a list, which adds node at end of the list.
+\param node The node to insert.
+*/
+static inline void list_insert_before(Node *const next, Node *const node)
+{
+    node->next = next;
+    node->prev = next->prev;
+    next->prev->next = node;
+    next->prev = node;
+}
+
+
+/**
+\brief Add node to head of list.
+
+\param list The list to add the node to.
+\param node The node to add.
+*/
+static inline void list_add_head(List *const list, Node *const node)
+{
+    list_insert_before((Node *) list->head.next, node);
+}
+
+
+/**
+\brief Add node to end of list.
+
+\param list The list to add the node to.
+\param node The node to add.
+*/
+static inline void list_add_tail(List *const list, Node *const node)
+{
+    list_insert_before((Node *) &list->tail, node);
+}
+
+
+/**
+\brief Get head of list.
+
+The list is not modified.
+
+\param list The list to get head of.
+\return Head of list, or NULL if list is empty.
+*/
+static inline Node *list_get_head(List *const list)
+{
+    if (list_is_empty(list)) {
+        return NULL;
+    } else {
+        return (Node *) list->head.next;
+    }
+}
+
+
+/**
+\brief Get tail of list.
+
+The list is not modified.
+
+\param list The list to get tail of.
+\return Tail of list, or NULL if list is empty.
+*/
+static inline Node *list_get_tail(List *const list)
+{
+    if (list_is_empty(list)) {
+        return NULL;
+    } else {
+        return (Node *) list->tail.prev;
+    }
+}
+
+
+/**
+\brief Remove head node of list.
+
+\param list The list for which the head will be removed.
+\return The removed node, or NULL if list was empty.
+*/
+static inline Node *list_rem_head(List *const list)
+{
+    Node *const node = list_get_head(list);
+
+    if (NULL != node) {
+        list_unlink(node);
+    }
+    return node;
+}
+
+
+/**
+\brief Remove tail node of list.
+
+\param list The list for which the tail will be removed.
+\return The removed node, or NULL if list was empty.
+*/
+static inline Node *list_rem_tail(List *const list)
+{
+    Node *const node = list_get_tail(list);
+
+    if (NULL != node) {
+        list_unlink(node);
+    }
+    return node;
+}
+
+
+/**
+\brief Insert a node into a list.
+
+The node is inserted in list after a given node.
+
+\param list The list to insert into.
+\param node The node to insert.
+\param prev Insert node after this node. If NULL, then node
+is inserted at head of list.
+*/
+static inline void list_insert(
+    List *const list,
+    Node *const node,
+    Node *const prev
+)
+{
+    if (NULL == prev) {
+        list_add_head(list, node);
+    } else {
+        /* The tail sentinel follows the last node so this also
+        works at the end of the list. */
+        list_insert_before(prev->next, node);
+    }
+}
+
+
+/**
+\brief Move all nodes of a list to the end of another list.
+
+\param list The list to add the nodes to.
+\param from The list to take the nodes from. It is empty
+afterwards.
+*/
+static inline void list_splice(List *const list, List *const from)
+{
+    if (list_is_empty(from)) {
+        return;
+    }
+    from->head.next->prev = list->tail.prev;
+    list->tail.prev->next = from->head.next;
+    from->tail.prev->next = &list->tail;
+    list->tail.prev = from->tail.prev;
+    list_init(from);
+}
+
+
+/**
+\brief Enqueue node in list.
+
+The node is inserted in list before the first node with a
+priority lower than parameter node.
+
+\param list The list to insert into.
+\param node The node to insert.
+*/
+void list_enqueue(List *const list, Node *const node);
+
+
+/**
+\brief Find list node by name.
+
+The first node matching name is returned. More nodes can be
+searched by successively calling the function on the found
+nodes.
+
+\param start A list or node to start the search from.
+\param name The name to match.
+\return The first node with matching name, or NULL if none
+was found.
+*/
+Node *list_find(List *const start, char *const name);
+
+
+/**
+\brief Node of a priority list.
+*/
+typedef struct {
+    /* Link in PrioList nodes. */
+    MinNode node;
+    /* Link in PrioList prios if this is the first node with its
+    priority, else next is NULL. */
+    MinNode prio_node;
+    Node_Prio prio;
+} PrioNode;
+
+
+/**
+\brief Priority queue with FIFO order among equal priorities.
+
+In addition to the list of all nodes, the first node of each
+priority is kept on a separate list. Adding a node is linear in
+the number of distinct priorities in the queue, and removing is
+constant time, independent of the number of nodes.
+*/
+typedef struct {
+    List nodes;
+    List prios;
+} PrioList;
+
+
+/**
+\brief Static initializer for a PrioList.
+
+\param list The list object being initialized.
+*/
+#define PLIST_INIT(list) { \
+    LIST_INIT((list).nodes), \
+    LIST_INIT((list).prios) \
+}
+
+
+/**
+\brief Prepare a priority list for use.
+
+\param list The list to initialize.
+*/
+static inline void plist_init(PrioList *const list)
+{
+    list_init(&list->nodes);
+    list_init(&list->prios);
+}
+
+
+/**
+\brief Test if priority list is empty.
+
+\param list The list to check for emptiness.
+\return true if list is empty, false otherwise.
+*/
+static inline bool plist_is_empty(PrioList *const list)
+{
+    return list_is_empty(&list->nodes);
+}
+
+
+/**
+\brief Add node to priority list.
+
+The node is inserted after all nodes with a priority higher
+than or equal to node->prio.
+
+\param list The list to add the node to.
+\param node The node to add, with prio set.
+*/
+void plist_add(PrioList *const list, PrioNode *const node);
+
+
+/**
+\brief Remove node from priority list.
+
+\param list The list which node is on.
+\param node The node to remove.
+*/
+static inline void plist_remove(PrioList *const list, PrioNode *const node)
+{
+    PrioNode *next;
+
+    (void) list;
+    if (NULL != node->prio_node.next) {
+        /* Node is first in its group. Let the next node in the
+        group take over. */
+        next = (PrioNode *) node->node.next;
+        if (NULL != next->node.next && next->prio == node->prio) {
+            list_insert_before(
+              (Node *) &node->prio_node,
+              (Node *) &next->prio_node
+            );
+        }
+        list_unlink((Node *) &node->prio_node);
+        node->prio_node.next = NULL;
+    }
+    list_unlink((Node *) &node->node);
+}
+
+
+/**
+\brief Get head of priority list.
+
+\param list The list to get head of.
+\return The node with highest priority which was added first,
+or NULL if list is empty.
+*/
+static inline PrioNode *plist_get_head(PrioList *const list)
+{
+    return (PrioNode *) list_get_head(&list->nodes);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
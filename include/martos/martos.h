@@ -31,12 +31,14 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdint.h>
 #include <stdbool.h>
 #include <platform.h>
+#include <martos/list.h>
 
 /** \file */
 
-typedef int16_t Node_Prio;
-static const Node_Prio NODE_PRIO_MIN = INT16_MIN;
-static const Node_Prio NODE_PRIO_MAX = INT16_MAX;
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 static const Node_Prio TASK_PRIO_MIN = INT16_MIN;
 static const Node_Prio TASK_PRIO_MAX = INT16_MAX - 1;
 static const Node_Prio TASK_PRIO_EXCLUSIVE = INT16_MAX;
@@ -47,150 +49,62 @@ static const Signals SIGF_SINGLE = 0x0001;
 static const int SIGNALS_WIDTH = 16;
 typedef int_fast16_t NestCnt;
 
-
-typedef struct Node_ {
-    struct Node_ *next;
-    struct Node_ *prev;
-    /* name may be NULL, but then it can't be found by
-    list_find() and similar functions. */
-    char *name;
-    Node_Prio prio;
-} Node;
-
-
-typedef struct MinNode_ {
-    struct MinNode_ *next;
-    struct MinNode_ *prev;
-} MinNode;
-
-
-/**
-\brief Datatype for a list, double-ended queue and priority
-queue.
-
-List is implemented with a doubly linked list.
-*/
+/* Set of processor cores. Bit n is core n. */
+typedef uint32_t CpuSet;
+static const int CPUS_WIDTH = 32;
+static const CpuSet CPUSET_ALL = UINT32_MAX;
 
 typedef struct {
-    MinNode head;
-    MinNode tail;
-} List;
-
-
-/**
-\brief Unlink node from list.
-
-The modified list is implicit.
-
-\param node The node to unlink.
-*/
-void list_unlink(Node *const node);
-
-
-/**
-\brief Prepare a list for list operations.
-
-This function must be applied to the list before any other
-list operation can take place.
-
-\param list The list to initialize.
-*/
-void list_init(List *const list);
-
-
-/**
-\brief Test if list is empty.
-
-\param list The list to check for emptiness.
-\return true if list is empty, false otherwise.
-*/
-bool list_is_empty(List *const list);
-
-
-/**
-\brief Add node to end of list.
-
-\param list The list to add the node to.
-\param node The node to add.
-*/
-void list_add_tail(List *const list, Node *const node);
+    volatile uint32_t locked;
+} Spinlock;
 
-
-/**
-\brief Remove head node of list.
-
-\param list The list for which the head will be removed.
-\return The removed node, or NULL if list was empty.
-*/
-Node *list_rem_head(List *const list);
-
-
-/**
-\brief Get head of list.
-
-The list is not modified.
-
-\param list The list to get head of.
-\return Head of list.
-*/
-Node *list_get_head(List *const list);
+#define SPINLOCK_INIT {0}
 
 
 /**
-\brief Insert a node into a list.
-
-The node is inserted in list after a given node.
+\brief Disable interrupts.
 
-\param list The list to insert into.
-\param node The node to insert.
-\param prev Insert node after this node. If NULL, then node
-is inserted at head of list.
+Disabling of interrupts nest. Each disable() must be paired
+with an enable().
 */
-void list_insert(List *const list, Node *const node, Node *const prev);
+void disable(void);
 
 
 /**
-\brief Enqueue node in list.
-
-The node is inserted in list before the first node with a
-priority lower than parameter node.
+\brief Enable interrupts.
 
-\param list The list to insert into.
-\param node The node to insert.
+Each enable() must be preceded by a disable().
 */
-void list_enqueue(List *const list, Node *const node);
+void enable(void);
 
 
 /**
-\brief Find list node by name.
+\brief Acquire a spinlock.
 
-The first node matching name is returned. More nodes can be
-searched by successively calling the function on the found
-nodes.
+Busy waits until lock is free. Interrupts are not disabled, so
+a lock which is shared with an interrupt handler must be taken
+within disable(). The kernel itself is protected by disable()
+which excludes all cores.
 
-\param start A list or node to start the search from.
-\param name The name to match.
-\return The first node with matching name, or NULL if none
-was found.
+\param lock The lock, initialized with SPINLOCK_INIT.
 */
-Node *list_find(List *const start, char *const name);
+void spin_lock(Spinlock *const lock);
 
 
 /**
-\brief Disable interrupts.
+\brief Release a spinlock.
 
-Disabling of interrupts nest. Each disable() must be paired
-with an enable().
+\param lock A lock held by the caller.
 */
-void disable(void);
+void spin_unlock(Spinlock *const lock);
 
 
 /**
-\brief Enable interrupts.
+\brief Get executing processor core.
 
-Each enable() must be preceded by a disable().
+\return Index of the core, 0 <= index < CPUS.
 */
-void enable(void);
+uint_fast8_t cpu_id(void);
 
 
 typedef enum {
@@ -201,7 +115,81 @@ typedef enum {
     TASK_WAITING
 } Task_State;
 
-typedef struct {
+typedef enum {
+    TIMER_NONE,
+    TIMER_DELAY,
+    TIMER_ALARM,
+    TIMER_PERIODIC
+} Timer_Operation;
+
+/** What timer_wait() returns for expirations of a periodic timer
+which were not waited for in time. */
+typedef enum {
+    /** Return all of them so that the missed periods can be
+    made up for. */
+    TIMER_CATCH_UP,
+    /** Return only one, the others are dropped. */
+    TIMER_SKIP
+} Timer_Missed;
+
+typedef enum {
+    TIMER_INVALID,
+    TIMER_INITIALIZED,
+    TIMER_ADDED,
+    TIMER_DONE,
+    TIMER_ABORTED
+} Timer_Status;
+
+typedef struct Timer_ {
+    Node node;
+    struct Task_ *task;
+    /** The task will be sent this signal by the timer
+    service. A timer without a signal or callback is the timeout
+    of its task, see signal_wait_timeout(). */
+    Signals signal;
+    /** The number of timer ticks to delay when op =
+    TIMER_DELAY. */
+    Ticks delay;
+    /** The timer tick at which task will be signalled signal
+    when op = TIMER_ALARM, and the first one when op =
+    TIMER_PERIODIC. */
+    Ticks tick;
+    /** The request may expire up to slack ticks late. Requests
+    whose windows overlap are then expired at the same tick, which
+    saves wakeups. Must be less than period. */
+    Ticks slack;
+    /** Tick at which the request expires, set by the kernel. */
+    Ticks expires;
+    /** Ticks between expirations when op = TIMER_PERIODIC. Each
+    expiration is period ticks after the previous one, so the
+    phase of the first one is kept. */
+    Ticks period;
+    /** Handling of missed periods when op = TIMER_PERIODIC. */
+    Timer_Missed missed;
+    /** Expirations not yet returned by timer_wait(). */
+    uint32_t pending;
+    /** Number of expirations which happened while the previous
+    one was still pending. */
+    uint32_t overruns;
+    /** If not NULL, called by the timer service task on expiry
+    instead of signalling task, see timer_init_callback(). */
+    void (*callback)(struct Timer_ *const timer);
+    /** For use by callback. */
+    void *user_data;
+    /** If not NULL, replied to its port when the request ends
+    instead of signalling task, see timer_init_message(). */
+    struct Message_ *message;
+    /** Links the request to the timer service while expired. */
+    MinNode expired;
+    Timer_Operation op;
+    Timer_Status status;
+} Timer;
+
+
+/* Weight given to tasks by task_init() and TASK_DECLARE(). */
+enum {TASK_WEIGHT_DEFAULT = 256};
+
+typedef struct Task_ {
     Node node;
     TaskContext context;
     Signals sig_alloc;
@@ -210,6 +198,27 @@ typedef struct {
     Signals sig_recvd;
     NestCnt id_nestcnt;
     Task_State state;
+    /* Time partition the task belongs to. 0 is the system
+    partition. */
+    uint8_t partition;
+    /* Share of the processor relative to other tasks of the same
+    priority when fair share scheduling is enabled. */
+    uint16_t weight;
+    /* Run time in processor cycles scaled by TASK_WEIGHT_DEFAULT /
+    weight. */
+    uint64_t vruntime;
+    /* Cores the task may execute on. */
+    CpuSet affinity;
+    /* Core the task runs or is ready on. */
+    uint8_t cpu;
+    /* Release parameters if task is periodic, else NULL. */
+    struct Periodic_ *periodic;
+    /* SemaphoreRequests of the task which are in wait queues. */
+    List requests;
+    /* Timeout of the timed waits of the task. */
+    Timer timeout;
+    /* Set when timeout expires. */
+    bool timed_out;
 } Task;
 
 
@@ -267,12 +276,104 @@ Task *task_find(char *const name);
 /**
 \brief Set scheduling priority of a task.
 
+A task which is ready or waits in kernel wait queues is
+repositioned according to its new priority.
+
 \param task The task to set priority of.
 \param prio New priority of task.
 */
 void task_set_prio(Task *const task, const Node_Prio prio);
 
 
+/**
+\brief Set of time partitions.
+
+Bit n is set if partition n is a member of the set.
+*/
+typedef uint32_t PartitionSet;
+static const int PARTITIONS_WIDTH = 32;
+
+/**
+\brief A window in the major frame of the partition schedule.
+*/
+typedef struct {
+    /** Length of the window in timer ticks. */
+    Ticks length;
+    /** Partitions which may execute during the window. */
+    PartitionSet partitions;
+} PartitionWindow;
+
+
+/**
+\brief The static partition schedule.
+
+The major frame consists of PARTITION_WINDOWS windows which
+are activated in order and then repeated. The table must be
+defined by the user when the kernel is built with
+PARTITION_WINDOWS > 0.
+*/
+extern const PartitionWindow partition_schedule[];
+
+
+/**
+\brief Assign a task to a time partition.
+
+Tasks in partition 0, the system partition, are eligible for
+execution in every window. This is the default for all tasks,
+including the init task. Other tasks only execute during the
+windows which enable their partition, or when their partition
+is the background partition and the active window has no
+ready task.
+
+\param task The task to assign.
+\param partition Partition number, 0 <= partition <
+PARTITIONS_WIDTH.
+*/
+void task_set_partition(Task *const task, const uint_fast8_t partition);
+
+
+/**
+\brief Get overrun count of a partition window.
+
+A window overruns if any of its partitions still has a task
+ready for execution when the window ends.
+
+\param window Index into partition_schedule.
+\return Number of times window has overrun.
+*/
+uint32_t partition_overruns(const uint_fast8_t window);
+
+
+/**
+\brief Set fair share weight of a task.
+
+When the kernel is built with FAIR_SHARE, ready tasks of the
+same priority are run in order of least weighted run time
+instead of round-robin, so that each gets processor time in
+proportion to its weight. Strict priority still applies
+between priority levels. Without FAIR_SHARE the weight is
+ignored.
+
+\param task The task.
+\param weight Relative share, > 0. Default is TASK_WEIGHT_DEFAULT.
+*/
+void task_set_weight(Task *const task, const uint16_t weight);
+
+
+/**
+\brief Restrict the cores a task may execute on.
+
+A task which is running or ready on a core outside affinity
+is moved to one of the cores in it.
+
+\param task The task.
+\param affinity Set of allowed cores. At least one of the CPUS
+cores the kernel is built for must be included. Default is
+CPUSET_ALL.
+*/
+void task_set_affinity(Task *const task, const CpuSet affinity);
+
+
 /**
 \brief Allocate signal bit.
 
@@ -303,19 +404,50 @@ void signal_send(Task *const task, const Signals signals);
 */
 Signals signal_wait(const Signals signals);
 
-typedef int_fast16_t SemaphoreCount;
+
+/**
+\brief Wait for bit signals with a timeout.
+
+The timeout is kept in the Task, so nothing is allocated.
+
+\param signals Signals to wait for.
+\param timeout Largest number of timer ticks to wait, at most
+TIMER_DELAY_MAX. 0 does not block, see signal_try_wait().
+\return The received signals, or 0 if the timeout expired first.
+*/
+Signals signal_wait_timeout(const Signals signals, const Ticks timeout);
+
+
+/**
+\brief Take bit signals which have already been received.
+
+\return The received signals, 0 if none of them had been.
+*/
+Signals signal_try_wait(const Signals signals);
+
+/* 32 bits so that the count can be updated atomically. */
+typedef int32_t SemaphoreCount;
 
 typedef struct {
     /* This list contains SemaphoreRequests. */
-    List req_queue;
-    SemaphoreCount count;
+    PrioList req_queue;
+    /* Negative when there are requests in req_queue. Updated
+    atomically, so uncontended waits and signals do not disable
+    interrupts. */
+    volatile SemaphoreCount count;
 } Semaphore;
 
-/* Used for asynchronous semaphore operations. */
+/* Used for asynchronous semaphore operations. Kernel wait queues
+are priority lists of requests, ordered by the priority of the
+waiter. */
 typedef struct {
-    MinNode node;
+    PrioNode node;
+    /* Link in waiter->requests. */
+    MinNode task_node;
     Task *waiter;
     Signals signal;
+    /* The wait queue of the request, or NULL if not queued. */
+    PrioList *queue;
 } SemaphoreRequest;
 
 void sem_init(Semaphore *const sem, const SemaphoreCount count);
@@ -336,6 +468,184 @@ do a signal_wait on the semaphore request signal.
 bool sem_add_request(Semaphore *const sem, SemaphoreRequest *const req);
 
 
+/**
+\brief Take a request out of a semaphore queue.
+
+This is how a wait made with sem_add_request() is given up, for
+example on a timeout. The request shall not be used after it has
+been granted or cancelled.
+\return
+- true if the request was still queued. It is removed and the
+semaphore is not taken.
+- false if the semaphore had already been granted to it. The
+caller holds the semaphore and the request signal has been sent.
+*/
+bool sem_cancel_request(Semaphore *const sem, SemaphoreRequest *const req);
+
+
+/**
+\brief Wait for a semaphore with a timeout.
+
+\param timeout Largest number of timer ticks to wait, at most
+TIMER_DELAY_MAX. 0 does not block.
+\return true if the semaphore was taken, false on timeout.
+*/
+bool sem_wait_timeout(Semaphore *const sem, const Ticks timeout);
+
+
+/**
+\brief Take a semaphore if it is free.
+
+\return true if the semaphore was taken.
+*/
+bool sem_try_wait(Semaphore *const sem);
+
+
+/** Condition variable. Tasks wait on it with a Semaphore of
+count 1 used as a mutex. */
+typedef struct {
+    /* SemaphoreRequests of the waiting tasks. */
+    PrioList waiters;
+} CondVar;
+
+void cond_init(CondVar *const cond);
+
+
+/**
+\brief Wait on a condition variable.
+
+The mutex, which the caller holds, is released and the task
+queued on cond in one step, so a cond_signal() made after the
+release is not missed. The mutex is taken again before return.
+Waiters are woken in priority order. As the condition may have
+changed before the mutex is taken again, it shall be checked in a
+loop.
+*/
+void cond_wait(CondVar *const cond, Semaphore *const mutex);
+
+
+/**
+\brief Wait on a condition variable with a timeout.
+
+\param timeout Largest number of timer ticks to wait, at most
+TIMER_DELAY_MAX.
+\return false if the timeout expired before the task was woken.
+The mutex is taken again in both cases.
+*/
+bool cond_wait_timeout(
+    CondVar *const cond,
+    Semaphore *const mutex,
+    const Ticks timeout
+);
+
+
+/** Wake the highest priority waiter, if any. */
+void cond_signal(CondVar *const cond);
+
+
+/** Wake all waiters. */
+void cond_broadcast(CondVar *const cond);
+
+
+/** Reusable barrier for a fixed number of tasks. */
+typedef struct {
+    /* SemaphoreRequests of the tasks which have arrived. */
+    PrioList waiters;
+    /* Number of tasks which pass the barrier together. */
+    uint16_t parties;
+    /* Number of tasks which have arrived in this generation. */
+    uint16_t arrived;
+    /* Incremented each time the barrier opens. */
+    uint32_t generation;
+} Barrier;
+
+typedef enum {
+    /** The barrier opened. */
+    BARRIER_PASSED,
+    /** The barrier opened at the arrival of this task. One task
+    of each generation gets this. */
+    BARRIER_LAST,
+    /** The timeout expired first. The task is not counted as
+    arrived. */
+    BARRIER_TIMEOUT
+} Barrier_Status;
+
+void barrier_init(Barrier *const barrier, const uint16_t parties);
+
+
+/**
+\brief Wait until parties tasks have arrived at a barrier.
+
+The last task to arrive wakes all the others in one disabled
+section and opens the next generation, so the barrier can be
+waited on again at once.
+*/
+Barrier_Status barrier_wait(Barrier *const barrier);
+
+
+/**
+\brief Wait at a barrier with a timeout.
+
+\param timeout Largest number of timer ticks to wait, at most
+TIMER_DELAY_MAX.
+*/
+Barrier_Status barrier_wait_timeout(
+    Barrier *const barrier,
+    const Ticks timeout
+);
+
+
+/** RwLock.count bias while a writer holds or waits for the lock. */
+#define RWLOCK_WRITER ((int32_t) 0x40000000)
+
+/** Reader-writer lock. Any number of readers or one writer may
+hold it. A waiting writer is preferred: new readers wait until no
+writer holds or waits for the lock. */
+typedef struct {
+    /* Number of readers, minus RWLOCK_WRITER while a writer holds
+    or waits for the lock. Readers take and release the lock with
+    an atomic update while it is not negative. */
+    volatile int32_t count;
+    /* SemaphoreRequests of waiting readers and writers. */
+    PrioList readers;
+    PrioList writers;
+    /* A writer holds the lock. */
+    bool writer;
+} RwLock;
+
+void rwlock_init(RwLock *const lock);
+
+
+/**
+\brief Take a reader-writer lock shared.
+
+The lock is taken without disable() if no writer holds or waits
+for it. Otherwise the task waits in priority order.
+*/
+void rwlock_read_lock(RwLock *const lock);
+
+
+void rwlock_read_unlock(RwLock *const lock);
+
+
+/**
+\brief Take a reader-writer lock exclusive.
+
+New readers are held back from the call on. Writers are served
+before waiting readers, each in priority order.
+*/
+void rwlock_write_lock(RwLock *const lock);
+
+
+/**
+\brief Release an exclusive lock.
+
+The lock is handed to the next waiting writer, if any, else all
+waiting readers are let in.
+*/
+void rwlock_write_unlock(RwLock *const lock);
+
+
 /**
 \brief User entry point to system.
 
@@ -368,7 +678,7 @@ typedef struct {
 } MsgPort;
 
 
-typedef struct {
+typedef struct Message_ {
     MinNode node;
     MsgPort *reply_port;
 } Message;
@@ -383,6 +693,34 @@ void msgport_init(MsgPort *const port);
 Message *msgport_wait(MsgPort *const port);
 
 
+/**
+\brief Wait for a message with a timeout.
+
+Like msgport_wait(), the message is left at the head of the port.
+
+\param timeout Largest number of timer ticks to wait, at most
+TIMER_DELAY_MAX. 0 does not block.
+\return The first message, or NULL on timeout.
+*/
+Message *msgport_wait_timeout(MsgPort *const port, const Ticks timeout);
+
+
+/**
+\brief Peek at the first message without blocking.
+
+\return The first message, or NULL if the port is empty.
+*/
+Message *msgport_try_wait(MsgPort *const port);
+
+
+/**
+\brief Take the first message from the port.
+
+The next pointer of the message is cleared, which marks a
+TimerMessage as received.
+
+\return The message, or NULL if the port was empty.
+*/
 Message *msgport_get(MsgPort *const port);
 
 
@@ -392,46 +730,305 @@ void msgport_send(MsgPort *const port, Message *const message);
 void msgport_reply(Message *const message);
 
 
-typedef enum {
-    TIMER_NONE,
-    TIMER_DELAY,
-    TIMER_ALARM
-} Timer_Operation;
-
-typedef enum {
-    TIMER_INVALID,
-    TIMER_INITIALIZED,
-    TIMER_ADDED,
-    TIMER_DONE,
-    TIMER_ABORTED
-} Timer_Status;
-
+/** Bounded queue of fixed size items which are copied into a ring
+buffer. */
 typedef struct {
-    Node node;
-    Task *task;
-    /** The task will be sent this signal by the timer
-    service. */
-    Signals signal;
-    /** The number of timer ticks to delay when op =
-    TIMER_DELAY. */
-    Ticks delay;
-    /** The timer tick at which task will be signalled signal
-    when op = TIMER_ALARM. */
-    Ticks tick;
-    Timer_Operation op;
-    Timer_Status status;
-} Timer;
+    uint8_t *buffer;
+    uint32_t item_size;
+    uint32_t capacity;
+    /* Index of the oldest item. */
+    uint32_t head;
+    uint32_t count;
+    /* SemaphoreRequests of tasks waiting for space and for
+    items. */
+    PrioList senders;
+    PrioList receivers;
+} Queue;
 
 
 /**
-\brief Wait for a specified number of timer ticks.
+\brief Initialize a queue before use.
 
-\param ticks The number of ticks to wait for.
+\param buffer Storage for capacity items of item_size bytes.
 */
-void timer_delay(const Ticks ticks);
+void queue_init(
+    Queue *const queue,
+    void *const buffer,
+    const uint32_t item_size,
+    const uint32_t capacity
+);
 
 
-/**
+/** Copy an item to the tail of a queue, waiting while it is
+full. */
+void queue_send(Queue *const queue, const void *const item);
+
+
+/**
+\brief Copy an item to a queue, waiting at most timeout ticks.
+
+\return false if the queue was still full at the timeout.
+*/
+bool queue_send_timeout(
+    Queue *const queue,
+    const void *const item,
+    const Ticks timeout
+);
+
+
+/**
+\brief Copy an item to a queue if there is space.
+
+This function is callable from interrupt context.
+\return false if the queue was full.
+*/
+bool queue_try_send(Queue *const queue, const void *const item);
+
+
+/** Copy the item at the head of a queue to item and remove it,
+waiting while the queue is empty. */
+void queue_receive(Queue *const queue, void *const item);
+
+
+/**
+\brief Receive an item, waiting at most timeout ticks.
+
+\return false if the queue was still empty at the timeout.
+*/
+bool queue_receive_timeout(
+    Queue *const queue,
+    void *const item,
+    const Ticks timeout
+);
+
+
+/**
+\brief Receive an item if there is one.
+
+This function is callable from interrupt context.
+\return false if the queue was empty.
+*/
+bool queue_try_receive(Queue *const queue, void *const item);
+
+
+/** Single producer, single consumer byte ring. The producer may
+be an interrupt routine and writes without disable(). */
+typedef struct {
+    uint8_t *buffer;
+    /* A power of two. */
+    uint32_t size;
+    /* Free running write and read counts. */
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    /* The reading task and its signal. */
+    Task *task;
+    Signals signal;
+    /* Bytes the reader waits for, 0 if it does not wait. */
+    volatile uint32_t wanted;
+} StreamBuffer;
+
+
+/**
+\brief Initialize a stream buffer before use.
+
+Must be called by the reading task. A signal is allocated.
+
+\param buffer Storage of size bytes, a power of two.
+*/
+void stream_init(
+    StreamBuffer *const stream,
+    void *const buffer,
+    const uint32_t size
+);
+
+
+/**
+\brief Append bytes to a stream buffer.
+
+The bytes are written without disable(), so this function is
+callable from interrupt context, but only one context may write
+to a stream. The reader is signalled when the number of bytes it
+waits for is reached.
+
+\return Number of bytes written, less than length if the buffer
+became full.
+*/
+uint32_t stream_write(
+    StreamBuffer *const stream,
+    const void *const data,
+    const uint32_t length
+);
+
+
+/** Number of bytes which can be read. */
+static inline uint32_t stream_available(StreamBuffer *const stream)
+{
+    return stream->head - stream->tail;
+}
+
+
+/**
+\brief Wait until at least count bytes can be read.
+
+The reader is woken once when count is reached, not for every
+write, so count acts as a trigger level.
+
+\return Number of bytes which can be read.
+*/
+uint32_t stream_wait(StreamBuffer *const stream, const uint32_t count);
+
+
+/**
+\brief Wait for count bytes, at most timeout ticks.
+
+\return Number of bytes which can be read, which is less than
+count on timeout.
+*/
+uint32_t stream_wait_timeout(
+    StreamBuffer *const stream,
+    const uint32_t count,
+    const Ticks timeout
+);
+
+
+/**
+\brief Get the readable bytes in place.
+
+The bytes are not copied. If they wrap around the end of the
+buffer, only the first part is returned and the rest follows
+after stream_consume().
+
+\param data Set to the first readable byte.
+\return Number of contiguous bytes at data.
+*/
+uint32_t stream_peek(StreamBuffer *const stream, const uint8_t **const data);
+
+
+/** Release count bytes which have been read to the writer. */
+void stream_consume(StreamBuffer *const stream, const uint32_t count);
+
+
+/** A published sample. Put it first in the structure which holds
+the data. It is shared by the subscribers and counted. */
+typedef struct Sample_ {
+    uint32_t refs;
+    struct Topic_ *topic;
+} Sample;
+
+/** A topic which samples are published to. */
+typedef struct Topic_ {
+    /* Subscriptions. */
+    List subscribers;
+    /* Called with interrupts disabled when the last reference to a
+    sample is released, typically to return it to a pool. */
+    void (*release)(Sample *const sample);
+    uint32_t published;
+} Topic;
+
+/** A subscription to a topic, delivered to a message port. */
+typedef struct {
+    /** Sent to port when samples are pending. */
+    Message message;
+    MinNode node;
+    Topic *topic;
+    MsgPort *port;
+    /* Ring of pending samples, oldest first. */
+    Sample **backlog;
+    uint16_t depth;
+    uint16_t first;
+    uint16_t count;
+    /* message is at the port or being handled. */
+    bool notified;
+    /* Slot used as backlog for latest value only. */
+    Sample *latest;
+    /** Pending samples replaced by newer ones. */
+    uint32_t dropped;
+} Subscription;
+
+
+/**
+\brief Initialize a topic before use.
+
+\param release Called when the last reference to a published
+sample is released. It may be NULL. It is called with interrupts
+disabled, from topic_publish(), topic_release() or
+topic_unsubscribe() and thus possibly in interrupt context. It
+must be short and must not block.
+*/
+void topic_init(Topic *const topic, void (*const release)(Sample *const sample));
+
+
+/**
+\brief Subscribe to a topic.
+
+When samples are published and none were pending, the message of
+the subscription is sent to port. The task then takes the pending
+samples with topic_receive() until it returns NULL, and the port
+can be waited on together with other messages. When depth samples
+are pending, the oldest is dropped for a new one.
+
+\param backlog Storage for depth pending samples, or NULL for
+latest value only: one pending sample which is replaced by newer
+ones.
+\param depth Number of entries in backlog. Ignored if backlog is
+NULL.
+*/
+void topic_subscribe(
+    Topic *const topic,
+    Subscription *const sub,
+    MsgPort *const port,
+    Sample **const backlog,
+    const uint16_t depth
+);
+
+
+/**
+\brief Cancel a subscription.
+
+Pending samples are released. If the message of the subscription
+is still at the port it is taken back, so the subscription can be
+made again.
+*/
+void topic_unsubscribe(Subscription *const sub);
+
+
+/**
+\brief Publish a sample to all subscribers of a topic.
+
+The sample is not copied. It is released when the last subscriber
+has released it, at once if there are no subscribers. This
+function is callable from interrupt context.
+*/
+void topic_publish(Topic *const topic, Sample *const sample);
+
+
+/**
+\brief Take the oldest pending sample of a subscription.
+
+Shall only be called after the message of the subscription has
+been taken from the port. The caller holds a reference to the
+sample and releases it with topic_release().
+
+\return The sample, or NULL when none are pending. A later
+publish then sends the message again.
+*/
+Sample *topic_receive(Subscription *const sub);
+
+
+/** Release a reference to a sample, which is the reply to the
+publisher. */
+void topic_release(Sample *const sample);
+
+
+/**
+\brief Wait for a specified number of timer ticks.
+
+\param ticks The number of ticks to wait for.
+*/
+void timer_delay(const Ticks ticks);
+
+
+/**
 \brief Get the current timer tick.
 
 \return system tick.
@@ -439,6 +1036,87 @@ void timer_delay(const Ticks ticks);
 Ticks timer_get_clock(void);
 
 
+/** Largest number of ticks between two ticks which are compared
+with timer_reached(), and largest delay of a Timer. */
+#define TIMER_DELAY_MAX ((Ticks) INT32_MAX)
+
+
+/**
+\brief Check if a tick has been reached.
+
+The ticks are compared by their difference, so the result is
+correct across wrap-around of the clock as long as tick and now
+are at most TIMER_DELAY_MAX ticks apart.
+
+\param tick The tick to check.
+\param now Current tick, for example from timer_get_clock().
+\return true if now is at or after tick.
+*/
+static inline bool timer_reached(const Ticks tick, const Ticks now)
+{
+    return 0 <= (int32_t) (now - tick);
+}
+
+
+/**
+\brief Get the 64-bit timer tick count.
+
+The low word is timer_get_clock(). The count does not wrap
+around in the lifetime of the system. It is read without tearing
+from any context.
+
+\return Ticks since the start of the timer.
+*/
+uint64_t timer_get_clock64(void);
+
+
+/**
+\brief Get a monotonic time stamp with sub-tick resolution.
+
+The tick count is combined with the hardware counter of the timer
+which drives the tick. The resolution is platform dependent.
+
+\return Nanoseconds since the start of the timer.
+*/
+uint64_t timer_get_ns(void);
+
+
+/** Microseconds since the start of the timer. */
+static inline uint64_t timer_get_us(void)
+{
+    return timer_get_ns() / 1000;
+}
+
+
+/** Convert a number of ticks to nanoseconds. */
+static inline uint64_t timer_ticks_to_ns(const uint64_t ticks)
+{
+    return ticks * PLATFORM_TICK_NS;
+}
+
+
+/** Convert nanoseconds to ticks, rounded up so that a delay is
+at least as long as requested. */
+static inline uint64_t timer_ns_to_ticks(const uint64_t ns)
+{
+    return (ns + PLATFORM_TICK_NS - 1) / PLATFORM_TICK_NS;
+}
+
+
+/** Convert a number of ticks to microseconds. */
+static inline uint64_t timer_ticks_to_us(const uint64_t ticks)
+{
+    return timer_ticks_to_ns(ticks) / 1000;
+}
+
+
+/** Convert microseconds to ticks, rounded up. */
+static inline uint64_t timer_us_to_ticks(const uint64_t us)
+{
+    return timer_ns_to_ticks(us * 1000);
+}
+
+
 /** Allocate resources for Timer and prepare it.
 */
 void timer_allocate(Timer *const timer);
@@ -460,17 +1138,470 @@ add the request:
 
 - If operation = TIMER_ALARM then timer->tick must be set.
 
+- If operation = TIMER_PERIODIC then timer->tick and
+timer->period must be set. The timer stays added and signals
+the task every period until it is aborted.
+
+A tick which has already elapsed, or is more than TIMER_DELAY_MAX
+ticks ahead, gives status TIMER_ABORTED and nothing is added. Ticks are
+compared across wrap-around of the clock. Adding takes constant
+time independent of the number of timers.
+
 \param timer The Timer to add.
 */
 void timer_add(Timer *const timer);
 
 
+/**
+\brief Get the number of wakeups saved by timer slack.
+
+\return Number of timer expiries which were moved by their slack
+to a tick with another expiry.
+*/
+uint32_t timer_get_wakeups_saved(void);
+
+
+/**
+\brief Wait for a timer request to expire.
+
+The timer must belong to the calling task and have been added
+with status TIMER_ADDED. The expirations counted in
+timer->pending are taken.
+
+\param timer The added request to wait for.
+\return Number of expirations since the previous call: one for a
+TIMER_DELAY or TIMER_ALARM request. For a TIMER_PERIODIC request
+it is more than one if periods were missed and timer->missed is
+TIMER_CATCH_UP.
+*/
+uint32_t timer_wait(Timer *const timer);
+
+
 /**
 \brief Abort a timer request.
 
+An added request is removed in constant time and gets status
+TIMER_ABORTED. An aborted TimerMessage is replied. Other requests
+are left unchanged.
+
 \param timer The previoiusly added request to abort.
 */
 void timer_abort(Timer *const timer);
 
+
+/**
+\brief Prepare a Timer which calls a function on expiry.
+
+The callback is called by the timer service task, at priority
+TIMER_SERVICE_PRIO, instead of a signal being sent. No signal is
+allocated. The expirations of a TIMER_PERIODIC request give one
+call each, or one call for all of them if timer->missed is
+TIMER_SKIP. Callbacks of requests which expire together are run
+in one batch. Set op and the time as for any other request and
+add it with timer_add(). timer_abort() also drops an expiry whose
+callback has not yet started. Requires the kernel to be built
+with TIMER_SERVICE.
+
+\param timer The Timer to prepare.
+\param callback Function to call with timer as parameter.
+\param user_data Stored in timer->user_data.
+*/
+void timer_init_callback(
+    Timer *const timer,
+    void (*const callback)(Timer *const timer),
+    void *const user_data
+);
+
+
+/** A timer request which is a message. */
+typedef struct {
+    /** Replied to message.reply_port when the request ends. */
+    Message message;
+    Timer timer;
+} TimerMessage;
+
+
+/**
+\brief Prepare a Timer which is replied as a message.
+
+The request is replied to port when it expires, with status
+TIMER_DONE, or when it is aborted or added with a tick which has
+already passed, with status TIMER_ABORTED. Each timer_add() gives
+exactly one reply, so any number of timeouts can be received on
+one port together with other messages, and no signal is
+allocated. Set timer.op and the time as for any other request and
+add it with timer_add(). The request can be added again once the
+reply has been received, that is taken from the port with
+msgport_get(). Until then timer_add() is ignored and leaves the
+status as it is, also after timer_abort(). TIMER_PERIODIC is not
+supported.
+
+\param request The request to prepare.
+\param port Port to reply to. The TimerMessage is received as
+its message member.
+*/
+void timer_init_message(TimerMessage *const request, MsgPort *const port);
+
+
+/** Statistics of the timer service task. */
+typedef struct {
+    /** Number of wakeups of the service. */
+    uint32_t batches;
+    /** Number of callbacks called. */
+    uint32_t callbacks;
+    /** Largest number of requests handled in one wakeup. */
+    uint32_t batch_max;
+    /** Longest execution time of a callback in nanoseconds. */
+    uint32_t callback_max;
+    /** Number of times the service has paused for a tick because
+    it had run longer than TIMER_SERVICE_LIMIT_US. */
+    uint32_t deferrals;
+} TimerServiceStats;
+
+
+/**
+\brief Get statistics of the timer service task.
+
+\param stats Receives a consistent copy of the statistics.
+*/
+void timer_service_get_stats(TimerServiceStats *const stats);
+
+
+/**
+\brief High resolution one-shot timer request.
+
+The task is signalled from the interrupt of a hardware compare
+channel rather than from the timer tick, so deadlines are resolved
+below the tick. The requests are kept apart from the Timer
+requests and are meant for short delays.
+*/
+typedef struct {
+    Node node;
+    Task *task;
+    /** The task will be sent this signal at the deadline. */
+    Signals signal;
+    /** Expiry time on the time base of timer_get_ns(). */
+    uint64_t deadline;
+    /** Nanoseconds from deadline to when the request was handled,
+    for the latest expiry. */
+    uint32_t latency;
+    Timer_Status status;
+} HrTimer;
+
+
+/** Wakeup latency of all expired HrTimer requests. */
+typedef struct {
+    /** Number of expired requests. */
+    uint32_t count;
+    /** Least, largest and summed latency in nanoseconds. */
+    uint32_t latency_min;
+    uint32_t latency_max;
+    uint64_t latency_sum;
+} HrTimerStats;
+
+
+/** Allocate a signal for the HrTimer and prepare it. */
+void hrtimer_allocate(HrTimer *const timer);
+
+
+void hrtimer_free(HrTimer *const timer);
+
+
+/**
+\brief Add a high resolution timer request.
+
+timer->deadline must be set. A deadline which has already passed
+gives status TIMER_ABORTED and nothing is added. Adding is linear
+in the number of pending HrTimer requests.
+
+\param timer The HrTimer to add.
+*/
+void hrtimer_add(HrTimer *const timer);
+
+
+/**
+\brief Abort a high resolution timer request.
+
+An added request is removed and gets status TIMER_ABORTED.
+
+\param timer The previously added request to abort.
+*/
+void hrtimer_abort(HrTimer *const timer);
+
+
+/**
+\brief Wait for a number of nanoseconds with a HrTimer.
+
+\param ns The number of nanoseconds to wait for.
+*/
+void hrtimer_delay(const uint32_t ns);
+
+
+/**
+\brief Get wakeup latency statistics of HrTimer requests.
+
+\param stats Receives a consistent copy of the statistics.
+*/
+void hrtimer_get_stats(HrTimerStats *const stats);
+
+
+/**
+\brief Release parameters and statistics of a periodic task.
+
+All times are in timer ticks. The statistics fields are updated
+by task_wait_period() and may be read by anyone.
+*/
+typedef struct Periodic_ {
+    /** Time between releases. */
+    Ticks period;
+    /** Relative deadline of each job. */
+    Ticks deadline;
+    /** Declared worst case execution time, or 0 if unknown. */
+    Ticks wcet;
+    /** Release time of current job. */
+    Ticks release;
+    /** Used for waiting on next release. */
+    Timer timer;
+    /** Number of completed jobs. */
+    uint32_t jobs;
+    /** Number of jobs which completed after the next release
+    time. */
+    uint32_t overruns;
+    /** Number of jobs which completed after their deadline. */
+    uint32_t deadline_misses;
+    /** Release jitter: start time minus release time. */
+    Ticks jitter_min;
+    Ticks jitter_max;
+    /** Response time: completion time minus release time. */
+    Ticks response_min;
+    Ticks response_max;
+    /** Sum of all response times. */
+    uint32_t response_sum;
+} Periodic;
+
+
+/**
+\brief Make a task periodic.
+
+The first job is released now. The task must call
+task_wait_period() at the end of each job. Releases are
+anchored to the first release so they do not drift.
+
+If the kernel is built with PERIODIC_ADMISSION, a rate
+monotonic utilization test is made over all periodic tasks
+with a declared wcet. The task is not made periodic if the
+test fails.
+
+\param task The task, which must not be scheduled yet.
+\param periodic Storage for release parameters and statistics.
+It must be valid as long as the task is periodic.
+\param period Time between releases, > 0.
+\param deadline Relative deadline, 0 < deadline <= period.
+\param wcet Declared worst case execution time, or 0.
+\return true if the task was made periodic, false if it was
+rejected by the admission test.
+*/
+bool task_set_periodic(
+    Task *const task,
+    Periodic *const periodic,
+    const Ticks period,
+    const Ticks deadline,
+    const Ticks wcet
+);
+
+
+/**
+\brief Complete current job and wait for next release.
+
+Must be called by a periodic task only. If the next release
+has already passed, the overrun is counted and the function
+returns immediately so that the task can catch up.
+*/
+void task_wait_period(void);
+
+
+/**
+\brief Declaration of a static task.
+
+TASK_DECLARE() emits one of these and a pointer to it in section
+.martos_tasks, which the linker collects into a table.
+*/
+typedef struct {
+    Task *task;
+    /* Copied to the top of the task stack at boot. */
+    StackFrame frame;
+} TaskDeclaration;
+
+
+/* Memory placement of the stacks emitted by TASK_DECLARE(), for
+example PLATFORM_CCM. Stacks are placed with other .bss by
+default. */
+#ifndef TASK_STACK_PLACEMENT
+    #define TASK_STACK_PLACEMENT
+#endif
+
+/* Static initializer of the timeout of a task. */
+#define TASK_TIMEOUT_INIT(owner) { \
+    .task = (owner), \
+    .op = TIMER_DELAY, \
+    .status = TIMER_INITIALIZED \
+}
+
+/**
+\brief Declare a task at compile time.
+
+The task object is emitted pre-initialized into .data and its
+stack into .bss. At boot, all declared tasks are made ready in
+one pass once the init task has set up the timers and before it
+calls user_init(), so neither task_init() nor task_schedule()
+shall be called on them. The task name is the
+identifier of the task object.
+
+\param task Identifier of the Task object to define.
+\param priority Pre-emptive scheduling priority of task.
+\param init_pc Execution entry point of task.
+\param user_data Parameter to execution entry point.
+\param stack_size Size of task stack, a multiple of 8.
+\param signals Signal mask allocated to the task from start,
+used by MSGPORT_DECLARE() and TIMER_DECLARE().
+*/
+#define TASK_DECLARE(task, priority, init_pc, user_data, stack_size, signals) \
+    TASK_STACK_PLACEMENT static uint32_t task##_stack[(stack_size) / 4] \
+      __attribute__ ((aligned (8))); \
+    Task task = { \
+        .node = {.name = #task, .prio = (priority)}, \
+        .context = TASKCONTEXT_INIT( \
+            (StackFrame *) ((uint8_t *) task##_stack + (stack_size) - \
+              sizeof (StackFrame)), \
+            task##_stack, \
+            (uint8_t *) task##_stack + (stack_size) \
+        ), \
+        /* SIGF_SINGLE is always allocated. */ \
+        .sig_alloc = 0x0001 | (signals), \
+        .id_nestcnt = -1, \
+        .state = TASK_INITIALIZED, \
+        .weight = TASK_WEIGHT_DEFAULT, \
+        /* CPUSET_ALL */ \
+        .affinity = UINT32_MAX, \
+        .requests = LIST_INIT(task.requests), \
+        .timeout = TASK_TIMEOUT_INIT(&task) \
+    }; \
+    static const TaskDeclaration task##_declaration = { \
+        &task, \
+        STACKFRAME_INIT(init_pc, user_data) \
+    }; \
+    static const TaskDeclaration *const task##_declaration_entry \
+      __attribute__ ((section (".martos_tasks"), used)) = \
+        &task##_declaration
+
+
+/**
+\brief Declare a semaphore at compile time.
+
+\param sem Identifier of the Semaphore object to define.
+\param initial Initial count.
+*/
+#define SEM_DECLARE(sem, initial) \
+    Semaphore sem = { \
+        .req_queue = PLIST_INIT(sem.req_queue), \
+        .count = (initial) \
+    }
+
+
+/**
+\brief Declare a condition variable at compile time.
+
+\param cond Identifier of the CondVar object to define.
+*/
+#define COND_DECLARE(cond) \
+    CondVar cond = { \
+        .waiters = PLIST_INIT(cond.waiters) \
+    }
+
+
+/**
+\brief Declare a queue and its buffer at compile time.
+
+\param queue Identifier of the Queue object to define.
+\param type Type of the items.
+\param length Capacity in items.
+*/
+#define QUEUE_DECLARE(queue, type, length) \
+    static type queue##_buffer[length]; \
+    Queue queue = { \
+        .buffer = (uint8_t *) queue##_buffer, \
+        .item_size = sizeof (type), \
+        .capacity = (length), \
+        .senders = PLIST_INIT(queue.senders), \
+        .receivers = PLIST_INIT(queue.receivers) \
+    }
+
+
+/**
+\brief Declare a barrier at compile time.
+
+\param barrier Identifier of the Barrier object to define.
+\param count Number of tasks which pass the barrier together.
+*/
+#define BARRIER_DECLARE(barrier, count) \
+    Barrier barrier = { \
+        .waiters = PLIST_INIT(barrier.waiters), \
+        .parties = (count) \
+    }
+
+
+/**
+\brief Declare a reader-writer lock at compile time.
+
+\param lock Identifier of the RwLock object to define.
+*/
+#define RWLOCK_DECLARE(lock) \
+    RwLock lock = { \
+        .readers = PLIST_INIT(lock.readers), \
+        .writers = PLIST_INIT(lock.writers) \
+    }
+
+
+/**
+\brief Declare a message port at compile time.
+
+\param port Identifier of the MsgPort object to define.
+\param owner Identifier of the owning task, declared with
+TASK_DECLARE().
+\param signum Signal number of the port. It must be included
+in the signals given to TASK_DECLARE().
+*/
+#define MSGPORT_DECLARE(port, owner, signum) \
+    MsgPort port = { \
+        .message_list = LIST_INIT(port.message_list), \
+        .task = &(owner), \
+        .signal = 1 << (signum), \
+        .action = MSGPORT_SIGNAL \
+    }
+
+
+/**
+\brief Declare a timer at compile time.
+
+The timer is in the state left by timer_allocate().
+
+\param timer Identifier of the Timer object to define.
+\param owner Identifier of the owning task, declared with
+TASK_DECLARE().
+\param signum Signal number of the timer. It must be included
+in the signals given to TASK_DECLARE().
+*/
+#define TIMER_DECLARE(timer, owner, signum) \
+    Timer timer = { \
+        .task = &(owner), \
+        .signal = 1 << (signum), \
+        .op = TIMER_NONE, \
+        .status = TIMER_INITIALIZED \
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
 
@@ -0,0 +1,237 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MARTOS_HPP
+#define MARTOS_HPP
+
+#include <stdint.h>
+#include <type_traits>
+#include <martos/martos.h>
+
+/** \file
+
+C++ interface to the kernel. Everything is header-only and
+inline, and compiles to the same calls as the C interface in
+martos.h. The C types are used directly where no type safety
+is gained by wrapping them.
+*/
+
+namespace martos {
+
+/**
+\brief Test if prio is a valid user task priority.
+*/
+constexpr bool prio_is_valid(const Node_Prio prio)
+{
+    return TASK_PRIO_MIN <= prio && prio <= TASK_PRIO_MAX;
+}
+
+/**
+\brief Required alignment of task stack sizes.
+*/
+constexpr uint32_t STACK_ALIGN = 4;
+
+/**
+\brief Test if a task stack size is valid.
+
+The stack must hold at least the initial stack frame and its
+size must be a multiple of STACK_ALIGN.
+*/
+constexpr bool stack_size_is_valid(const uint32_t size)
+{
+    return sizeof (StackFrame) <= size && 0 == size % STACK_ALIGN;
+}
+
+
+/**
+\brief Task with its stack held inline.
+
+\tparam StackSize Size of task stack in bytes.
+\tparam Prio Pre-emptive scheduling priority of task.
+*/
+template <uint32_t StackSize, Node_Prio Prio>
+class Task {
+    static_assert(prio_is_valid(Prio), "invalid task priority");
+    static_assert(stack_size_is_valid(StackSize), "invalid stack size");
+
+public:
+    static constexpr uint32_t stack_size = StackSize;
+    static constexpr Node_Prio prio = Prio;
+
+    /** See task_init(). */
+    void init(
+        const char *const name,
+        void (*const entry) (void *user_data),
+        void *const user_data = nullptr
+    )
+    {
+        task_init(
+            &task,
+            const_cast<char *>(name),
+            Prio,
+            entry,
+            user_data,
+            stack,
+            StackSize
+        );
+    }
+
+    /** See task_schedule(). */
+    void schedule()
+    {
+        task_schedule(&task);
+    }
+
+    /** Get the C task object. */
+    ::Task *native()
+    {
+        return &task;
+    }
+
+private:
+    ::Task task;
+    alignas(STACK_ALIGN) uint8_t stack[StackSize];
+};
+
+
+template <typename T>
+class MsgPort;
+
+/**
+\brief Message with payload of type T.
+*/
+template <typename T>
+struct Message {
+    /** Must be first so that the C message converts to us. */
+    ::Message message;
+    T data;
+
+    /** Set the port which msgport_reply() sends to. */
+    void set_reply_port(MsgPort<T> &port)
+    {
+        message.reply_port = port.native();
+    }
+
+    /** See msgport_reply(). */
+    void reply()
+    {
+        msgport_reply(&message);
+    }
+};
+
+
+/**
+\brief Message port which only carries Message<T>.
+*/
+template <typename T>
+class MsgPort {
+    static_assert(
+        std::is_standard_layout<Message<T> >::value,
+        "Message<T> must be standard layout"
+    );
+
+public:
+    /** See msgport_init(). */
+    void init()
+    {
+        msgport_init(&port);
+    }
+
+    /** See msgport_send(). */
+    void send(Message<T> &message)
+    {
+        msgport_send(&port, &message.message);
+    }
+
+    /** See msgport_wait(). */
+    Message<T> *wait()
+    {
+        return reinterpret_cast<Message<T> *>(msgport_wait(&port));
+    }
+
+    /** See msgport_get(). */
+    Message<T> *get()
+    {
+        return reinterpret_cast<Message<T> *>(msgport_get(&port));
+    }
+
+    /** Get the C message port object. */
+    ::MsgPort *native()
+    {
+        return &port;
+    }
+
+private:
+    ::MsgPort port;
+};
+
+
+/**
+\brief Holds a semaphore for the lifetime of the guard.
+*/
+class SemaphoreGuard {
+public:
+    explicit SemaphoreGuard(::Semaphore &semaphore) : sem(semaphore)
+    {
+        sem_wait(&sem);
+    }
+
+    ~SemaphoreGuard()
+    {
+        sem_signal(&sem);
+    }
+
+    SemaphoreGuard(const SemaphoreGuard &) = delete;
+    SemaphoreGuard &operator=(const SemaphoreGuard &) = delete;
+
+private:
+    ::Semaphore &sem;
+};
+
+
+/**
+\brief Disables interrupts for the lifetime of the guard.
+*/
+class CriticalSection {
+public:
+    CriticalSection()
+    {
+        disable();
+    }
+
+    ~CriticalSection()
+    {
+        enable();
+    }
+
+    CriticalSection(const CriticalSection &) = delete;
+    CriticalSection &operator=(const CriticalSection &) = delete;
+};
+
+}
+
+#endif
@@ -72,57 +72,34 @@ void sys_sem_signal(sys_sem_t *sem)
     sem_signal(sem);
 }
 
+/* Convert an lwIP timeout in milliseconds to a timer delay. */
+static Ticks timeout_ticks(const u32_t timeout)
+{
+    uint64_t ticks = timer_us_to_ticks((uint64_t) timeout * 1000);
+
+    if (TIMER_DELAY_MAX < ticks) {
+        ticks = TIMER_DELAY_MAX;
+    }
+    return ticks;
+}
+
+/* Milliseconds since start. The unsigned difference is correct
+across wrap-around of the clock. */
+static u32_t elapsed_ms(const Ticks start)
+{
+    return timer_ticks_to_us((Ticks) (timer_get_clock() - start)) / 1000;
+}
+
 u32_t sys_arch_sem_wait(sys_sem_t *sem, u32_t timeout)
 {
-    u32_t end_time;
     Ticks start_time = timer_get_clock();
-    SemaphoreRequest req;
-
-    req.signal = 1 << signal_allocate(-1);
-    assert(0 != req.signal);
-    req.waiter = task_find(NULL);
-    if (false == sem_add_request(sem, &req)) {
-        /* We got the semaphore very early. */
-        end_time = timer_get_clock() - start_time;
-        signal_free(req.signal);
-        return end_time;
-    } else {
-        /* Have to wait for it. */
-    }
- 
-    Timer timer;
-    Signals timer_signal = 0;
-
-    if (0 != timeout) {
-        /* Setup timer request. */
-        timer_allocate(&timer);
-        timer.op = TIMER_DELAY;
-        timer.delay = timeout;
-
-        timer_signal = timer.signal;
-        timer_add(&timer);
-    } else {
-        /* Block until arrival: timer_signal is 0. */
-    }
 
-    Signals got_signals = signal_wait(timer_signal | req.signal);
-    if (0 != (got_signals & req.signal)) {
-        /* Got semaphore or got semaphore and a timeout. */
-        end_time = timer_get_clock() - start_time;
-    } else if(0 != (got_signals & timer_signal)) {
-        /* Got only a timeout. */
-        end_time = SYS_ARCH_TIMEOUT;
-    } else {
-        /* We got a signal we didn't ask for! */
-        assert(true);
-        while(1);
-    }
-    if (0 != timer_signal) {
-        timer_abort(&timer);
-        timer_free(&timer);
+    if (0 == timeout) {
+        sem_wait(sem);
+    } else if (false == sem_wait_timeout(sem, timeout_ticks(timeout))) {
+        return SYS_ARCH_TIMEOUT;
     }
-    signal_free(req.signal);
-    return end_time;
+    return elapsed_ms(start_time);
 }
 
 err_t sys_mbox_new(sys_mbox_t *mbox, int size)
@@ -186,7 +163,6 @@ u32_t sys_arch_mbox_fetch(
 )
 {
     sys_msg_t *m;
-    u32_t end_time;
     Ticks start_time = timer_get_clock();
     /* Prepare message port for blocking. This should
     semantically be done in sys_mbox_new but that function may
@@ -198,48 +174,22 @@ u32_t sys_arch_mbox_fetch(
         assert(0 != mbox->signal);
     }
     mbox->action = MSGPORT_SIGNAL;
- 
-    Timer timer;
-    Signals timer_signal = 0;
-
-    if (0 != timeout) {
-        /* Setup timer request. */
-        timer_allocate(&timer);
-        timer.op = TIMER_DELAY;
-        timer.delay = timeout;
-
-        timer_signal = timer.signal;
-        timer_add(&timer);
-    } else {
-        /* Block until arrival: timer_signal is 0. */
-    }
 
-    Signals got_signals = signal_wait(timer_signal | mbox->signal);
-    if (0 != (got_signals & mbox->signal)) {
-        /* Got a message or got a message and a timeout. */
-        m = (sys_msg_t *) msgport_get(mbox);
-        assert(NULL != m);
-        if (NULL != msg) {
-        	/* Give message to user. */
-        	*msg = m->ptr;
-        } else {
-        	/* Drop the message. */
-        }
-        mem_free(m);
-        end_time = timer_get_clock() - start_time;
-    } else if(0 != (got_signals & timer_signal)) {
-        /* Got only a timeout. */
-        end_time = SYS_ARCH_TIMEOUT;
-    } else {
-        /* We got a signal we didn't ask for! */
-        assert(true);
-        while(1);
+    if (0 == timeout) {
+        msgport_wait(mbox);
+    } else if (NULL == msgport_wait_timeout(mbox, timeout_ticks(timeout))) {
+        return SYS_ARCH_TIMEOUT;
     }
-    if (0 != timer_signal) {
-        timer_abort(&timer);
-        timer_free(&timer);
+    m = (sys_msg_t *) msgport_get(mbox);
+    assert(NULL != m);
+    if (NULL != msg) {
+        /* Give message to user. */
+        *msg = m->ptr;
+    } else {
+        /* Drop the message. */
     }
-    return end_time;
+    mem_free(m);
+    return elapsed_ms(start_time);
 }
 
 u32_t sys_arch_mbox_tryfetch(sys_mbox_t *mbox, void **msg)
@@ -298,7 +248,7 @@ sys_thread_t sys_thread_new(
 
 u32_t sys_now(void)
 {
-    return timer_get_clock();
+    return timer_get_us() / 1000;
 }
 
 #if 0
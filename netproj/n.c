@@ -35,8 +35,11 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "udpecho.h"
 
 #define N_STACK_SIZE 4096
+#define N_PERIOD 250
 Task n1;
 Task n2;
+Periodic n1_periodic;
+Periodic n2_periodic;
 uint8_t n1_stack[N_STACK_SIZE];
 uint8_t n2_stack[N_STACK_SIZE];
 
@@ -62,27 +65,12 @@ void n1_f(void)
     res = netbuf_ref(buf, text, sizeof(text));
     assert(ERR_OK == res);
 
-    Timer timer;
-
-    timer_allocate(&timer);
-    timer.op = TIMER_ALARM;
-    timer.tick = timer_get_clock();
-
     while (1) {
-        timer.tick += 250;
         res = netconn_send(conn, buf);
         assert(ERR_OK == res);
         GPIO_ToggleBits(GPIOD, GPIO_Pin_13);
-
-        timer_add(&timer);
-        if (TIMER_ADDED == timer.status) {
-            signal_wait(timer.signal);
-        } else {
-            /* Already elapsed. */
-        	assert(true);
-        }
+        task_wait_period();
     }
-    timer_free(&timer);
     res = netconn_delete(conn);
     assert(ERR_OK == res);
 
@@ -92,24 +80,10 @@ void n1_f(void)
 
 void n2_f(void)
 {
-    Timer timer;
-
-    timer_allocate(&timer);
-    timer.op = TIMER_ALARM;
-    timer.tick = timer_get_clock();
-
     while (1) {
-        timer.tick += 250;
         GPIO_ToggleBits(GPIOD, GPIO_Pin_12);
-        timer_add(&timer);
-        if (TIMER_ADDED == timer.status) {
-            signal_wait(timer.signal);
-        } else {
-            /* Already elapsed. */
-        	assert(true);
-        }
+        task_wait_period();
     }
-    timer_free(&timer);
 }
 
 void user_init(void)
@@ -140,6 +114,8 @@ void user_init(void)
         &n2_stack,
         N_STACK_SIZE
     );
+    task_set_periodic(&n1, &n1_periodic, N_PERIOD, N_PERIOD, 0);
+    task_set_periodic(&n2, &n2_periodic, N_PERIOD, N_PERIOD, 0);
     task_schedule(&n1);
     task_schedule(&n2);
 }
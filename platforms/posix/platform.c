@@ -0,0 +1,469 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <martos/martos.h>
+#include <private.h>
+#include <platform_protos.h>
+#include <default_config.h>
+
+/* Hosted platform. Every task is executed by a host thread, and
+a task thread only runs while its task is the running task of
+one of the CPUS emulated cores, so there is true parallelism
+between cores. disable() takes the kernel spinlock instead of
+masking interrupts. The main thread is the interrupt context:
+it delivers the kernel tick, which drives both the timers and
+round-robin, and the HrTimer interrupt.
+
+A host thread can not be interrupted, so a pending context
+switch is taken when the task returns to interrupt level in
+enable() or when the core idles. A task which spins without
+calling the kernel is not preempted. */
+
+/* First timer tick. A value close to UINT32_MAX makes the clock
+wrap around soon after start. */
+#ifndef PLATFORM_CLOCK_START
+    #define PLATFORM_CLOCK_START 0
+#endif
+
+typedef struct Thread_ {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool resume;
+} Thread;
+
+/* Protects all kernel data, taken by disable(). */
+static Spinlock kernel_lock = SPINLOCK_INIT;
+/* Core which the calling thread executes on. */
+static __thread uint_fast8_t this_cpu;
+/* True for the thread which emulates interrupts. */
+static __thread bool in_interrupt;
+/* True if the calling thread holds kernel_lock. */
+static __thread bool lock_held;
+
+/* Context switch requested on core. */
+static volatile bool cpu_pending[CPUS];
+static pthread_mutex_t idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond[CPUS];
+
+static volatile Ticks timer_now;
+/* Upper word of the 64-bit tick count. */
+static volatile uint32_t timer_now_hi;
+/* Host time of the last tick in nanoseconds. */
+static uint64_t timer_host_ns;
+static volatile bool timer_enabled;
+
+/* Host time at which hrtimer_poll() is due, UINT64_MAX for none.
+hrtimer_cond is signalled when it changes. */
+static uint64_t hrtimer_host_ns = UINT64_MAX;
+static pthread_mutex_t hrtimer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t hrtimer_cond;
+
+PRIVATE void taskcontext_init(
+    TaskContext *const context,
+    void (*const init_pc) (void *const user_data),
+    void *const user_data,
+    void *const stack,
+    const uint32_t stack_size
+)
+{
+    StackFrame *frame;
+
+    assert(sizeof (StackFrame) <= stack_size);
+    frame = (StackFrame *)
+      ((uint8_t *) stack + stack_size - sizeof (StackFrame));
+    frame->pc = init_pc;
+    frame->r0 = user_data;
+
+    context->frame = frame;
+    context->bos = stack;
+    context->tos = (uint8_t *) stack + stack_size;
+    context->thread = NULL;
+    taskcontext_verify(context);
+}
+
+PRIVATE void taskcontext_verify(TaskContext *const context)
+{
+    assert((uintptr_t) context->bos <=
+      (uintptr_t) context->frame);
+    assert(((uintptr_t) context->frame + sizeof (StackFrame)) <=
+      (uintptr_t) context->tos);
+}
+
+void spin_lock(Spinlock *const lock)
+{
+    while (0 != __atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE)) {
+        while (0 != __atomic_load_n(&lock->locked, __ATOMIC_RELAXED)) {
+            /* The holder may be a host thread which is not
+            scheduled. */
+            sched_yield();
+        }
+    }
+}
+
+void spin_unlock(Spinlock *const lock)
+{
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+uint_fast8_t cpu_id(void)
+{
+    return this_cpu;
+}
+
+/* Monotonic host time in nanoseconds. */
+static uint64_t host_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+#if FAIR_SHARE
+/* Nanoseconds stand in for cycles. */
+PRIVATE uint32_t platform_cycles(void)
+{
+    return (uint32_t) host_ns();
+}
+#endif
+
+static void *thread_main(void *arg)
+{
+    Task *const task = arg;
+
+    this_cpu = task->cpu;
+    task->context.frame->pc(task->context.frame->r0);
+    /* Tasks shall not return. */
+    abort();
+    return NULL;
+}
+
+/* Let the thread of task continue on core task->cpu. */
+static void thread_resume(Task *const task)
+{
+    Thread *thread;
+    int ret;
+
+    thread = task->context.thread;
+    if (NULL == thread) {
+        thread = malloc(sizeof (Thread));
+        assert(NULL != thread);
+        pthread_mutex_init(&thread->mutex, NULL);
+        pthread_cond_init(&thread->cond, NULL);
+        thread->resume = false;
+        task->context.thread = thread;
+        ret = pthread_create(&thread->thread, NULL, thread_main, task);
+        assert(0 == ret);
+        (void) ret;
+        return;
+    }
+    pthread_mutex_lock(&thread->mutex);
+    thread->resume = true;
+    pthread_cond_signal(&thread->cond);
+    pthread_mutex_unlock(&thread->mutex);
+}
+
+/* Block the thread of task until it is resumed. */
+static void thread_park(Task *const task)
+{
+    Thread *const thread = task->context.thread;
+
+    pthread_mutex_lock(&thread->mutex);
+    while (false == thread->resume) {
+        pthread_cond_wait(&thread->cond, &thread->mutex);
+    }
+    thread->resume = false;
+    pthread_mutex_unlock(&thread->mutex);
+}
+
+/* The context switch. Called with kernel_lock held and
+id_nestcnt at 0 by the running task of the executing core. It
+returns when the task is switched in again, possibly on another
+core. */
+static void task_switch(void)
+{
+    Task *old;
+    Task *new;
+
+    cpu_pending[this_cpu] = false;
+    old = running;
+    task_verify(old);
+#if FAIR_SHARE
+    fair_charge(old);
+#endif
+    if (TASK_RUNNING == old->state) {
+        old->state = TASK_READY;
+        ready_enqueue(old);
+    }
+    new = task_next();
+    new->state = TASK_RUNNING;
+    running = new;
+    elapsed = QUANTUM;
+    task_verify(new);
+    if (new == old) {
+        return;
+    }
+
+    thread_resume(new);
+    /* Let the other cores in while this thread is parked. */
+    id_nestcnt = -1;
+    lock_held = false;
+    spin_unlock(&kernel_lock);
+    thread_park(old);
+    spin_lock(&kernel_lock);
+    lock_held = true;
+    id_nestcnt = 0;
+    this_cpu = old->cpu;
+}
+
+void disable(void)
+{
+    if (false == lock_held) {
+        spin_lock(&kernel_lock);
+        lock_held = true;
+    }
+    id_nestcnt++;
+}
+
+void enable(void)
+{
+    assert(lock_held);
+    assert(0 <= id_nestcnt);
+    /* Pending switches are taken when the interrupt level is
+    left. */
+    while (0 == id_nestcnt && false == in_interrupt &&
+      cpu_pending[this_cpu]) {
+        task_switch();
+    }
+    id_nestcnt--;
+    if (id_nestcnt < 0) {
+        lock_held = false;
+        spin_unlock(&kernel_lock);
+    }
+}
+
+PRIVATE void cpu_reschedule(const uint_fast8_t cpu)
+{
+    pthread_mutex_lock(&idle_mutex);
+    cpu_pending[cpu] = true;
+    pthread_cond_signal(&idle_cond[cpu]);
+    pthread_mutex_unlock(&idle_mutex);
+}
+
+PRIVATE void reschedule(void)
+{
+    cpu_reschedule(this_cpu);
+    if (false == in_interrupt && false == lock_held) {
+        /* Take it now, as PendSV would be. */
+        disable();
+        enable();
+    }
+}
+
+PRIVATE void cpu_idle(void)
+{
+    pthread_mutex_lock(&idle_mutex);
+    while (false == cpu_pending[this_cpu]) {
+        pthread_cond_wait(&idle_cond[this_cpu], &idle_mutex);
+    }
+    pthread_mutex_unlock(&idle_mutex);
+    disable();
+    enable();
+}
+
+PRIVATE void timer_init_platform(void)
+{
+    timer_now = PLATFORM_CLOCK_START;
+    timer_now_hi = 0;
+    timer_host_ns = host_ns();
+    timer_enabled = true;
+}
+
+Ticks timer_get_clock(void)
+{
+    return timer_now;
+}
+
+uint64_t timer_get_clock64(void)
+{
+    uint32_t hi;
+    Ticks lo;
+
+    /* Retry if the low word wrapped between the reads. */
+    do {
+        hi = timer_now_hi;
+        lo = timer_now;
+    } while (hi != timer_now_hi);
+    return ((uint64_t) hi << 32) | lo;
+}
+
+uint64_t timer_get_ns(void)
+{
+    uint64_t ticks;
+    uint64_t since;
+
+    disable();
+    ticks = timer_get_clock64();
+    since = host_ns() - timer_host_ns;
+    enable();
+    /* A late tick must not make the time jump backwards. */
+    if (PLATFORM_TICK_NS <= since) {
+        since = PLATFORM_TICK_NS - 1;
+    }
+    return ticks * PLATFORM_TICK_NS + since;
+}
+
+PRIVATE void hrtimer_program(const uint64_t deadline)
+{
+    uint64_t start;
+    uint64_t host;
+
+    if (HRTIMER_NONE == deadline) {
+        host = UINT64_MAX;
+    } else {
+        start = timer_get_clock64() * PLATFORM_TICK_NS;
+        host = timer_host_ns;
+        if (start < deadline) {
+            host += deadline - start;
+        }
+    }
+    pthread_mutex_lock(&hrtimer_mutex);
+    hrtimer_host_ns = host;
+    pthread_cond_signal(&hrtimer_cond);
+    pthread_mutex_unlock(&hrtimer_mutex);
+}
+
+/* Sleep until the host time until. Return true if a HrTimer
+deadline comes first. */
+static bool hrtimer_wait(const uint64_t until)
+{
+    struct timespec wake;
+    uint64_t now;
+    uint64_t at;
+    bool due;
+
+    due = false;
+    pthread_mutex_lock(&hrtimer_mutex);
+    while (1) {
+        now = host_ns();
+        if (until <= now) {
+            break;
+        }
+        if (hrtimer_host_ns <= now) {
+            due = true;
+            break;
+        }
+        at = until < hrtimer_host_ns ? until : hrtimer_host_ns;
+        wake.tv_sec = at / 1000000000;
+        wake.tv_nsec = at % 1000000000;
+        pthread_cond_timedwait(&hrtimer_cond, &hrtimer_mutex, &wake);
+    }
+    pthread_mutex_unlock(&hrtimer_mutex);
+    return due;
+}
+
+/* Count down the round-robin time slice of each core. */
+static void quantum_tick(void)
+{
+#if 1 < CPUS
+    uint_fast8_t cpu;
+
+    for (cpu = 0; cpu < CPUS; cpu++) {
+        cpus[cpu].slice--;
+        if (0 == cpus[cpu].slice) {
+            cpu_reschedule(cpu);
+        }
+    }
+#else
+    elapsed--;
+    if (0 == elapsed) {
+        cpu_reschedule(0);
+    }
+#endif
+}
+
+int main(void)
+{
+    pthread_condattr_t attr;
+    uint_fast8_t cpu;
+    uint64_t next;
+
+    /* The main thread delivers interrupts to core 0. */
+    in_interrupt = true;
+    this_cpu = 0;
+    for (cpu = 0; cpu < CPUS; cpu++) {
+        pthread_cond_init(&idle_cond[cpu], NULL);
+    }
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&hrtimer_cond, &attr);
+    martos_pre();
+#if FAIR_SHARE
+    fair_init();
+#endif
+#if 1 < CPUS
+    for (cpu = 0; cpu < CPUS; cpu++) {
+        thread_resume(cpus[cpu].current);
+    }
+#else
+    thread_resume(running);
+#endif
+
+    next = host_ns();
+    while (1) {
+        next += PLATFORM_TICK_NS;
+        while (hrtimer_wait(next)) {
+            disable();
+            hrtimer_poll();
+            enable();
+        }
+        disable();
+        if (timer_enabled) {
+            timer_now++;
+            if (0 == timer_now) {
+                timer_now_hi++;
+            }
+            timer_host_ns = host_ns();
+            timer_poll();
+#if PARTITION_WINDOWS
+            partition_tick();
+#endif
+        }
+        quantum_tick();
+        enable();
+    }
+    return 0;
+}
+
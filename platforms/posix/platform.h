@@ -0,0 +1,115 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* A host thread executes the task, so the frame only holds what
+is needed to start it. */
+typedef struct {
+    void (*pc) (void *);
+    void *r0;
+} StackFrame;
+
+typedef struct {
+    StackFrame *frame;
+    void *bos;
+    void *tos;
+    /* Host thread of the task. Created when the task is switched
+    in the first time. */
+    struct Thread_ *thread;
+} TaskContext;
+
+/* Static initializers used by TASK_DECLARE(). */
+#define STACKFRAME_INIT(init_pc, user_data) { \
+    .pc = (init_pc), \
+    .r0 = (void *) (user_data) \
+}
+
+#define TASKCONTEXT_INIT(frame_, bos_, tos_) { \
+    .frame = (frame_), \
+    .bos = (bos_), \
+    .tos = (tos_), \
+    .thread = 0 \
+}
+
+typedef uint32_t Ticks;
+
+/* Rate of the kernel tick which drives both the timers and
+round-robin. It is a build time parameter. */
+#ifndef TICK_RATE_HZ
+    #define TICK_RATE_HZ 1000
+#endif
+
+/* Length of a timer tick in nanoseconds. */
+#define PLATFORM_TICK_NS (1000000000u / TICK_RATE_HZ)
+
+/* The host has no special purpose memories. */
+#define PLATFORM_CCM
+#define PLATFORM_RAMFUNC
+
+/* Atomic counter operations, see the STM32F4 platform. */
+
+/* Add delta to *value if the result is at least min. Return true
+if it was added. */
+static inline bool platform_atomic_add_min(
+    volatile int32_t *const value,
+    const int32_t delta,
+    const int32_t min
+)
+{
+    int32_t old = __atomic_load_n(value, __ATOMIC_RELAXED);
+
+    do {
+        if (old + delta < min) {
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(value, &old, old + delta,
+      true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+    return true;
+}
+
+/* Add delta to *value and return the result. */
+static inline int32_t platform_atomic_add(
+    volatile int32_t *const value,
+    const int32_t delta
+)
+{
+    return __atomic_add_fetch(value, delta, __ATOMIC_SEQ_CST);
+}
+
+/* Full memory barrier for the compiler and the host. */
+static inline void platform_barrier(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif
+
@@ -35,6 +35,10 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <platform_protos.h>
 #include <default_config.h>
 
+#if 1 < CPUS
+    #error "The STM32F4 has one core"
+#endif
+
 static void dead_end(void)
 {
 }
@@ -130,6 +134,31 @@ void enable(void)
     }
 }
 
+void spin_lock(Spinlock *const lock)
+{
+    do {
+        while (0 != __LDREXW(&lock->locked)) {
+            ;
+        }
+    } while (0 != __STREXW(1, &lock->locked));
+    __DMB();
+}
+
+void spin_unlock(Spinlock *const lock)
+{
+    __DMB();
+    lock->locked = 0;
+}
+
+uint_fast8_t cpu_id(void)
+{
+    return 0;
+}
+
+PRIVATE void cpu_idle(void)
+{
+}
+
 void led_init(void)
 {
     RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_GPIOD, ENABLE);
@@ -150,20 +179,46 @@ StackFrame *platform_pre(void)
     context = martos_pre();
 
     NVIC_SetPriority(PendSV_IRQn, 0xFF);
-    SysTick_Config(SysTick->CALIB & SysTick_CALIB_TENMS_Msk);
+    /* The one kernel tick. It drives round-robin from now and the
+    timers from timer_init_platform(). */
+    SysTick_Config(SystemCoreClock / TICK_RATE_HZ);
     /* FIXME: NVIC_SetPriority is called in SysTick_Config...*/
     /* High priority? */
     NVIC_SetPriority(SysTick_IRQn, 0);
     led_init();
 
+    /* Enable the DWT cycle counter for platform_cycles(). */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#if FAIR_SHARE
+    fair_init();
+#endif
+
     __set_PSP((uint32_t) context->frame);
     return context->frame;
 }
 
-static void SysTick_Handler(void)
+static volatile Ticks timer_now;
+/* Upper word of the 64-bit tick count. */
+static volatile uint32_t timer_now_hi;
+/* Set when the kernel timers are initialized. */
+static volatile bool timer_enabled;
+
+KERNEL_CODE_PLACEMENT static void SysTick_Handler(void)
 {
-    elapsed--;
+    if (timer_enabled) {
+        timer_now++;
+        if (0 == timer_now) {
+            timer_now_hi++;
+        }
+        timer_poll();
+#if PARTITION_WINDOWS
+        partition_tick();
+#endif
+    }
 
+    elapsed--;
     if (0 == elapsed) {
         SCB->ICSR |= SCB_ICSR_PENDSVSET_Msk;
     }
@@ -172,7 +227,7 @@ static void SysTick_Handler(void)
        may have masked out the PendSV interrupt. */
 }
 
-void *PendSV_Handler_user(StackFrame *old_frame)
+KERNEL_CODE_PLACEMENT void *PendSV_Handler_user(StackFrame *old_frame)
 {
     /* Check task which is switched out. */
     task_verify(running);
@@ -182,11 +237,14 @@ void *PendSV_Handler_user(StackFrame *old_frame)
     __disable_irq();
 
     running->context.frame = old_frame;
+#if FAIR_SHARE
+    fair_charge(running);
+#endif
     switch (running->state) {
     case TASK_RUNNING:
         /* Maybe select new task to run. Check prio then Elapsed */
         running->state = TASK_READY;
-        list_enqueue(&ready, (Node *) running);
+        ready_enqueue(running);
         /* If no swap was needed, we can just return here, but
         fall through instead. If the task ended up at the head
         of running list then it will be removed again below. */
@@ -196,7 +254,7 @@ void *PendSV_Handler_user(StackFrame *old_frame)
         running->id_nestcnt = id_nestcnt;
         /* It is now switched out. */
         /* Ready for a new one. */
-        running = (Task *) list_rem_head(&ready);
+        running = task_next();
         running->state = TASK_RUNNING;
         id_nestcnt = running->id_nestcnt;
         elapsed = QUANTUM;
@@ -219,33 +277,41 @@ void *PendSV_Handler_user(StackFrame *old_frame)
     return running->context.frame;
 }
 
-static volatile Ticks timer_now;
+#if FAIR_SHARE
+KERNEL_CODE_PLACEMENT PRIVATE uint32_t platform_cycles(void)
+{
+    return DWT->CYCCNT;
+}
+#endif
+
+/* TIM5 counts microseconds over 32 bits for HrTimer compares. */
+enum {TIM5_COUNT_NS = 1000};
 
 PRIVATE void timer_init_platform(void)
 {
     timer_now = 0;
+    timer_now_hi = 0;
 
-    /* Set up hardware to generate timer interrupts. */
-    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
+    /* Free running TIM5 for the HrTimer compare channel. */
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM5, ENABLE);
 
     TIM_TimeBaseInitTypeDef timerInitStructure;
     timerInitStructure.TIM_Prescaler = 28 - 1; // 1MHz timebase
     timerInitStructure.TIM_CounterMode = TIM_CounterMode_Up;
-    timerInitStructure.TIM_Period = 1000-1;
+    timerInitStructure.TIM_Period = UINT32_MAX;
     timerInitStructure.TIM_ClockDivision = TIM_CKD_DIV1;
     timerInitStructure.TIM_RepetitionCounter = 0;
-    TIM_TimeBaseInit(TIM2, &timerInitStructure);
-    TIM_Cmd(TIM2, ENABLE);
-    TIM_ITConfig(TIM2, TIM_IT_Update, ENABLE);
+    TIM_TimeBaseInit(TIM5, &timerInitStructure);
+    TIM_Cmd(TIM5, ENABLE);
 
     NVIC_InitTypeDef nvicStructure;
-    nvicStructure.NVIC_IRQChannel = TIM2_IRQn;
+    nvicStructure.NVIC_IRQChannel = TIM5_IRQn;
     nvicStructure.NVIC_IRQChannelPreemptionPriority = 0;
     nvicStructure.NVIC_IRQChannelSubPriority = 1;
     nvicStructure.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&nvicStructure);
 
-    //TIM_ClearITPendingBit(TIM2, TIM_IT_Update);
+    timer_enabled = true;
 }
 
 Ticks timer_get_clock(void)
@@ -253,12 +319,75 @@ Ticks timer_get_clock(void)
     return timer_now;
 }
 
-static void TIM2_IRQHandler(void)
+uint64_t timer_get_clock64(void)
 {
-    if (TIM_GetITStatus(TIM2, TIM_IT_Update) != RESET) {
-        timer_now++;
-        timer_poll();
-        TIM_ClearITPendingBit(TIM2, TIM_IT_Update);
+    uint32_t hi;
+    Ticks lo;
+
+    /* Retry if the low word wrapped between the reads. */
+    do {
+        hi = timer_now_hi;
+        lo = timer_now;
+    } while (hi != timer_now_hi);
+    return ((uint64_t) hi << 32) | lo;
+}
+
+uint64_t timer_get_ns(void)
+{
+    uint64_t ticks;
+    uint32_t val;
+
+    disable();
+    ticks = timer_get_clock64();
+    val = SysTick->VAL;
+    if (0 != (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)) {
+        /* SysTick has wrapped but the tick is not yet counted.
+        Read the counter again since it may have been read before
+        the wrap. */
+        val = SysTick->VAL;
+        ticks++;
+    }
+    enable();
+    /* SysTick counts down from LOAD. */
+    return ticks * PLATFORM_TICK_NS +
+      (uint64_t) (SysTick->LOAD - val) * PLATFORM_TICK_NS /
+      (SysTick->LOAD + 1);
+}
+
+KERNEL_CODE_PLACEMENT PRIVATE void hrtimer_program(const uint64_t deadline)
+{
+    uint64_t now;
+    uint64_t delta;
+
+    TIM5->DIER &= ~TIM_DIER_CC1IE;
+    if (HRTIMER_NONE == deadline) {
+        return;
+    }
+    now = timer_get_ns();
+    if (deadline <= now) {
+        delta = 0;
+    } else {
+        delta = (deadline - now + TIM5_COUNT_NS - 1) / TIM5_COUNT_NS;
+    }
+    if (INT32_MAX < delta) {
+        /* Rearmed by hrtimer_poll() when it finds nothing due. */
+        delta = INT32_MAX;
+    }
+    TIM5->CCR1 = TIM5->CNT + delta;
+    TIM5->SR = ~TIM_SR_CC1IF;
+    TIM5->DIER |= TIM_DIER_CC1IE;
+    if (0 <= (int32_t) (TIM5->CNT - TIM5->CCR1)) {
+        /* Passed while arming. */
+        TIM5->EGR = TIM_EGR_CC1G;
+    }
+}
+
+KERNEL_CODE_PLACEMENT static void TIM5_IRQHandler(void)
+{
+    if (TIM_GetITStatus(TIM5, TIM_IT_CC1) != RESET) {
+        TIM_ClearITPendingBit(TIM5, TIM_IT_CC1);
+        TIM5->DIER &= ~TIM_DIER_CC1IE;
+        hrtimer_poll();
     }
 }
 
@@ -267,6 +396,9 @@ static void Default_Handler(void)
     for(;;);
 }
 
+/* TIM2 is free for the application, which may define it. */
+void TIM2_IRQHandler(void) __attribute__ ((weak, alias ("Default_Handler")));
+
 extern uint32_t _tos;
 
 void Reset_Handler(void);
@@ -358,6 +490,50 @@ PRIVATE void (*const vector_table[])(void)
 /* TIM1_CC_IRQHandler */
     Default_Handler,
 /* TIM2_IRQHandler */
-    TIM2_IRQHandler
+    TIM2_IRQHandler,
+/* TIM3_IRQHandler */
+    Default_Handler,
+/* TIM4_IRQHandler */
+    Default_Handler,
+/* I2C1_EV_IRQHandler */
+    Default_Handler,
+/* I2C1_ER_IRQHandler */
+    Default_Handler,
+/* I2C2_EV_IRQHandler */
+    Default_Handler,
+/* I2C2_ER_IRQHandler */
+    Default_Handler,
+/* SPI1_IRQHandler */
+    Default_Handler,
+/* SPI2_IRQHandler */
+    Default_Handler,
+/* USART1_IRQHandler */
+    Default_Handler,
+/* USART2_IRQHandler */
+    Default_Handler,
+/* USART3_IRQHandler */
+    Default_Handler,
+/* EXTI15_10_IRQHandler */
+    Default_Handler,
+/* RTC_Alarm_IRQHandler */
+    Default_Handler,
+/* OTG_FS_WKUP_IRQHandler */
+    Default_Handler,
+/* TIM8_BRK_TIM12_IRQHandler */
+    Default_Handler,
+/* TIM8_UP_TIM13_IRQHandler */
+    Default_Handler,
+/* TIM8_TRG_COM_TIM14_IRQHandler */
+    Default_Handler,
+/* TIM8_CC_IRQHandler */
+    Default_Handler,
+/* DMA1_Stream7_IRQHandler */
+    Default_Handler,
+/* FSMC_IRQHandler */
+    Default_Handler,
+/* SDIO_IRQHandler */
+    Default_Handler,
+/* TIM5_IRQHandler */
+    TIM5_IRQHandler
 };
 
@@ -29,6 +29,7 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define PLATFORM_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef struct {
     /* Software */
@@ -45,7 +46,97 @@ typedef struct {
     void *tos;
 } TaskContext;
 
+/* Static initializers used by TASK_DECLARE(). The frame is the
+same as the one set up by taskcontext_init(). */
+#define STACKFRAME_INIT(init_pc, user_data) { \
+    .r0 = (uint32_t) (user_data), \
+    .pc = (init_pc), \
+    .xpsr = 1 << 24 \
+}
+
+#define TASKCONTEXT_INIT(frame_, bos_, tos_) { \
+    .frame = (frame_), \
+    .bos = (bos_), \
+    .tos = (tos_) \
+}
+
 typedef uint32_t Ticks;
 
+/* Rate of the kernel tick which drives both the timers and
+round-robin. It is a build time parameter. */
+#ifndef TICK_RATE_HZ
+    #define TICK_RATE_HZ 1000
+#endif
+
+/* Length of a timer tick in nanoseconds. */
+#define PLATFORM_TICK_NS (1000000000u / TICK_RATE_HZ)
+
+/* Places an object in the 64K core coupled memory. CCM has no
+wait states and is not shared with DMA, but it is reachable
+only from the D-bus so it can hold data but not code. It is
+zero filled at reset; initializers are not loaded. */
+#define PLATFORM_CCM __attribute__ ((section (".ccm")))
+
+/* Places a function in SRAM. It is copied from flash with .data
+at reset and executes without flash wait states. Calls from
+flash go through linker generated long branch veneers. */
+#define PLATFORM_RAMFUNC __attribute__ ((section (".ramfunc")))
+
+/* Atomic counter operations made with exclusive load and store.
+The store fails and the operation is retried if another access
+to the counter, or an exception which clears the exclusive
+monitor, came between them. */
+
+/* Add delta to *value if the result is at least min. Return true
+if it was added. */
+static inline bool platform_atomic_add_min(
+    volatile int32_t *const value,
+    const int32_t delta,
+    const int32_t min
+)
+{
+    int32_t old;
+    uint32_t failed;
+
+    do {
+        __asm__ volatile ("ldrex %0, [%1]"
+          : "=r" (old) : "r" (value) : "memory");
+        if (old + delta < min) {
+            __asm__ volatile ("clrex" ::: "memory");
+            return false;
+        }
+        __asm__ volatile ("strex %0, %2, [%1]"
+          : "=&r" (failed) : "r" (value), "r" (old + delta) : "memory");
+    } while (0 != failed);
+    __asm__ volatile ("dmb" ::: "memory");
+    return true;
+}
+
+/* Add delta to *value and return the result. */
+static inline int32_t platform_atomic_add(
+    volatile int32_t *const value,
+    const int32_t delta
+)
+{
+    int32_t old;
+    uint32_t failed;
+
+    do {
+        __asm__ volatile ("ldrex %0, [%1]"
+          : "=r" (old) : "r" (value) : "memory");
+        __asm__ volatile ("strex %0, %2, [%1]"
+          : "=&r" (failed) : "r" (value), "r" (old + delta) : "memory");
+    } while (0 != failed);
+    __asm__ volatile ("dmb" ::: "memory");
+    return old + delta;
+}
+
+/* Full memory barrier. Memory accesses are not reordered across
+it by the compiler or the core. */
+static inline void platform_barrier(void)
+{
+    __asm__ volatile ("dmb" ::: "memory");
+}
+
 #endif
 
@@ -36,7 +36,8 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
     .type Reset_Handler, %function
 
 Reset_Handler:  
-    /* Copy data segment initializers from flash to SRAM. */
+    /* Copy data segment initializers from flash to SRAM. This
+    includes code in .ramfunc. */
     ldr     r0, =_sdata
     ldr     r1, =_sidata
     ldr     r2, =_data_size
@@ -48,6 +49,12 @@ Reset_Handler:
     ldr     r2, =_bss_size
     bl      memset
 
+    /* Zero fill the core coupled memory segment. */
+    ldr     r0, =_sccm
+    mov     r1, #0
+    ldr     r2, =_ccm_size
+    bl      memset
+
     /* CMSIS stuff for setting System clock etc. */
     bl      SystemInit
     /* Set up data structures and init_task. PSP is initialized.
@@ -0,0 +1,109 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <assert.h>
+#include <martos/martos.h>
+#include "private.h"
+
+/* Reusable barrier. The tasks which have arrived wait with a
+SemaphoreRequest on their stacks. A task which finds the
+generation changed when it is woken has passed. */
+
+void barrier_init(Barrier *const barrier, const uint16_t parties)
+{
+    assert(0 < parties);
+    plist_init(&barrier->waiters);
+    barrier->parties = parties;
+    barrier->arrived = 0;
+    barrier->generation = 0;
+}
+
+static Barrier_Status barrier_block(
+    Barrier *const barrier,
+    const bool timed,
+    const Ticks timeout
+)
+{
+    SemaphoreRequest req;
+    SemaphoreRequest *other;
+    Barrier_Status status;
+    uint32_t generation;
+
+    disable();
+    generation = barrier->generation;
+    barrier->arrived++;
+    if (barrier->parties == barrier->arrived) {
+        /* Open it. */
+        barrier->arrived = 0;
+        barrier->generation++;
+        while (NULL != (other = request_dequeue(&barrier->waiters))) {
+            signal_send(other->waiter, other->signal);
+        }
+        enable();
+        return BARRIER_LAST;
+    }
+
+    req.signal = SIGF_SINGLE;
+    req.waiter = running;
+    request_enqueue(&barrier->waiters, &req);
+    if (timed) {
+        task_timeout_start(timeout);
+    }
+    /* Wait again if woken by someone else. No signal means the
+    timeout expired. */
+    while (generation == barrier->generation &&
+      0 != signal_wait(SIGF_SINGLE)) {
+        ;
+    }
+    if (timed) {
+        task_timeout_stop();
+    }
+    if (generation == barrier->generation) {
+        /* Timed out, withdraw. */
+        request_remove(&req);
+        barrier->arrived--;
+        status = BARRIER_TIMEOUT;
+    } else {
+        status = BARRIER_PASSED;
+    }
+    enable();
+    return status;
+}
+
+Barrier_Status barrier_wait(Barrier *const barrier)
+{
+    return barrier_block(barrier, false, 0);
+}
+
+Barrier_Status barrier_wait_timeout(
+    Barrier *const barrier,
+    const Ticks timeout
+)
+{
+    return barrier_block(barrier, true, timeout);
+}
@@ -0,0 +1,115 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <assert.h>
+#include <martos/martos.h>
+#include "private.h"
+
+/* Condition variables. A waiter is queued with a SemaphoreRequest
+on its stack, in the same disabled section as the mutex is
+released, and is woken with SIGF_SINGLE. */
+
+void cond_init(CondVar *const cond)
+{
+    plist_init(&cond->waiters);
+}
+
+/* Queue the running task, release mutex and wait at most timeout
+ticks, or without timeout if timed is false. Return false on
+timeout. */
+static bool cond_block(
+    CondVar *const cond,
+    Semaphore *const mutex,
+    const bool timed,
+    const Ticks timeout
+)
+{
+    SemaphoreRequest req;
+    bool woken;
+
+    req.signal = SIGF_SINGLE;
+    req.waiter = running;
+    disable();
+    request_enqueue(&cond->waiters, &req);
+    sem_signal(mutex);
+    if (timed) {
+        task_timeout_start(timeout);
+    }
+    /* Wait again if woken by someone else. No signal means the
+    timeout expired. */
+    while (NULL != req.queue && 0 != signal_wait(SIGF_SINGLE)) {
+        ;
+    }
+    if (timed) {
+        task_timeout_stop();
+    }
+    woken = NULL == req.queue;
+    if (false == woken) {
+        request_remove(&req);
+    }
+    enable();
+    sem_wait(mutex);
+    return woken;
+}
+
+void cond_wait(CondVar *const cond, Semaphore *const mutex)
+{
+    cond_block(cond, mutex, false, 0);
+}
+
+bool cond_wait_timeout(
+    CondVar *const cond,
+    Semaphore *const mutex,
+    const Ticks timeout
+)
+{
+    return cond_block(cond, mutex, true, timeout);
+}
+
+void cond_signal(CondVar *const cond)
+{
+    SemaphoreRequest *req;
+
+    disable();
+    req = request_dequeue(&cond->waiters);
+    if (NULL != req) {
+        signal_send(req->waiter, req->signal);
+    }
+    enable();
+}
+
+void cond_broadcast(CondVar *const cond)
+{
+    SemaphoreRequest *req;
+
+    disable();
+    while (NULL != (req = request_dequeue(&cond->waiters))) {
+        signal_send(req->waiter, req->signal);
+    }
+    enable();
+}
@@ -27,10 +27,15 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <martos/martos.h>
 #include "private.h"
+#include "default_config.h"
 
-PRIVATE NestCnt id_nestcnt;
-PRIVATE uint_fast8_t elapsed;
-PRIVATE Task *running;
-PRIVATE List ready;
-PRIVATE List waiting;
+KERNEL_DATA_PLACEMENT PRIVATE NestCnt id_nestcnt;
+#if 1 < CPUS
+KERNEL_DATA_PLACEMENT PRIVATE Cpu cpus[CPUS];
+#else
+KERNEL_DATA_PLACEMENT PRIVATE uint_fast16_t elapsed;
+KERNEL_DATA_PLACEMENT PRIVATE Task *running;
+KERNEL_DATA_PLACEMENT PRIVATE List ready;
+#endif
+KERNEL_DATA_PLACEMENT PRIVATE List waiting;
 
@@ -25,11 +25,26 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
 USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-/* If round-robin is supported, this parameter defines how
-many system timer periods a task will stay running if other
-ready tasks have the same priority. */
-#ifndef QUANTUM
-    #define QUANTUM 4
+/* If round-robin is supported, this parameter defines how many
+microseconds a task will stay running if other ready tasks have
+the same priority. */
+#ifndef QUANTUM_US
+    #define QUANTUM_US 40000
+#endif
+
+/* The quantum rounded up to kernel ticks, so the time slice stays
+the same at any TICK_RATE_HZ. It must be 1..65535 ticks. */
+#define QUANTUM ((QUANTUM_US * 1ull * TICK_RATE_HZ + 999999) / 1000000)
+
+/* Number of processor cores to schedule tasks on. Each core but
+the first has an idle task, the first idles in the init task. */
+#ifndef CPUS
+    #define CPUS 1
+#endif
+
+/* Static stack space to allocate for each idle task. */
+#ifndef IDLE_TASK_STACK_SIZE
+    #define IDLE_TASK_STACK_SIZE 256
 #endif
 
 /* Static stack space to allocate for the init task. */
@@ -37,3 +52,81 @@ ready tasks have the same priority. */
     #define INIT_TASK_STACK_SIZE 2048
 #endif
 
+/* Number of windows in the major frame of the time partition
+schedule. The schedule itself is given by the user in
+partition_schedule[]. 0 disables time partitioning. */
+#ifndef PARTITION_WINDOWS
+    #define PARTITION_WINDOWS 0
+#endif
+
+/* Partition which is given the processor when the active window
+has no ready task. 0 means that idle time is not donated. */
+#ifndef PARTITION_BACKGROUND
+    #define PARTITION_BACKGROUND 0
+#endif
+
+/* Define to 1 to make task_set_periodic() reject tasks which
+would make the set of periodic tasks fail the rate monotonic
+utilization test. */
+#ifndef PERIODIC_ADMISSION
+    #define PERIODIC_ADMISSION 0
+#endif
+
+/* Define to 1 to share the processor between ready tasks of equal
+priority in proportion to their weights, see task_set_weight(). 0
+gives plain round-robin. */
+#ifndef FAIR_SHARE
+    #define FAIR_SHARE 0
+#endif
+
+/* Number of bits of the timer tick resolved by each level of the
+timer wheel. Each level has 2^TIMER_WHEEL_BITS slots and there are
+enough levels to cover the range of Ticks. More bits use more
+memory but cascade requests between levels less often. */
+#ifndef TIMER_WHEEL_BITS
+    #define TIMER_WHEEL_BITS 4
+#endif
+
+/* Max number of timer requests expired or cascaded, and ticks
+advanced, in one timer tick. Work beyond it is continued on the
+next tick so that the tick interrupt has a bounded length. */
+#ifndef TIMER_POLL_BUDGET
+    #define TIMER_POLL_BUDGET 64
+#endif
+
+/* Define to 1 to run a timer service task, which calls the
+callbacks of timers prepared with timer_init_callback(). */
+#ifndef TIMER_SERVICE
+    #define TIMER_SERVICE 0
+#endif
+
+/* Priority of the timer service task. Callbacks run at it. */
+#ifndef TIMER_SERVICE_PRIO
+    #define TIMER_SERVICE_PRIO TASK_PRIO_MAX
+#endif
+
+/* Static stack space to allocate for the timer service task. */
+#ifndef TIMER_SERVICE_STACK_SIZE
+    #define TIMER_SERVICE_STACK_SIZE 1024
+#endif
+
+/* Microseconds the timer service may run callbacks before it
+waits for the next tick, to let lower priority tasks run. 0 gives
+no limit. */
+#ifndef TIMER_SERVICE_LIMIT_US
+    #define TIMER_SERVICE_LIMIT_US 0
+#endif
+
+/* Memory placement of kernel control data: running task, ready
+and waiting lists, timer wheel and the init task. Set to for
+example PLATFORM_CCM. */
+#ifndef KERNEL_DATA_PLACEMENT
+    #define KERNEL_DATA_PLACEMENT
+#endif
+
+/* Memory placement of the kernel functions on the context switch
+and signalling paths. Set to for example PLATFORM_RAMFUNC. */
+#ifndef KERNEL_CODE_PLACEMENT
+    #define KERNEL_CODE_PLACEMENT
+#endif
+
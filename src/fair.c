@@ -0,0 +1,109 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <martos/martos.h>
+#include "private.h"
+#include "platform_protos.h"
+#include "default_config.h"
+
+/* Fair share scheduling within a priority level. Ready tasks are
+ordered by priority first and then by vruntime, the processor
+cycles they have consumed scaled by TASK_WEIGHT_DEFAULT /
+weight. The head of ready is thus the highest priority task
+which has had the least of its share. */
+
+/* Cycle count when the running task was charged last. */
+static uint32_t charged;
+
+/* Called by the platform when platform_cycles() runs, before the
+first task is switched in, so that it is not charged the time
+since reset. */
+PRIVATE void fair_init(void)
+{
+    charged = platform_cycles();
+}
+
+KERNEL_CODE_PLACEMENT PRIVATE void fair_charge(Task *const task)
+{
+    uint32_t now;
+
+    now = platform_cycles();
+    task->vruntime +=
+      (uint64_t) (now - charged) * TASK_WEIGHT_DEFAULT / task->weight;
+    charged = now;
+}
+
+/* A task which has been waiting is not allowed to start behind
+the tasks it shall compete with, or it would own the processor
+until it has caught up. */
+KERNEL_CODE_PLACEMENT PRIVATE void fair_wakeup(Task *const task)
+{
+    Node *node;
+    bool found;
+    uint64_t least;
+
+    found = false;
+    least = 0;
+    if (running != task && running->node.prio == task->node.prio) {
+        found = true;
+        least = running->vruntime;
+    }
+    LIST_FOR_EACH(node, &ready) {
+        if (node->prio == task->node.prio) {
+            /* First of its priority has the least vruntime. */
+            if (!found || ((Task *) node)->vruntime < least) {
+                found = true;
+                least = ((Task *) node)->vruntime;
+            }
+            break;
+        } else if (node->prio < task->node.prio) {
+            break;
+        }
+    }
+    if (found && task->vruntime < least) {
+        task->vruntime = least;
+    }
+}
+
+KERNEL_CODE_PLACEMENT PRIVATE void fair_enqueue(Task *const task)
+{
+    Node *node;
+
+    LIST_FOR_EACH(node, &ready) {
+        if (node->prio < task->node.prio) {
+            break;
+        }
+        if (node->prio == task->node.prio &&
+          task->vruntime < ((Task *) node)->vruntime) {
+            break;
+        }
+    }
+    list_insert_before(node, (Node *) task);
+}
+
@@ -0,0 +1,175 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <assert.h>
+#include <martos/martos.h>
+#include "private.h"
+#include "platform_protos.h"
+#include "default_config.h"
+
+/* High resolution timers. The requests are kept sorted by
+deadline and the platform is asked to interrupt at the deadline
+of the first one with hrtimer_program(). The interrupt calls
+hrtimer_poll(). There are normally only a few such requests so
+the sorted insert is cheap. */
+
+KERNEL_DATA_PLACEMENT static List hrtimers;
+KERNEL_DATA_PLACEMENT static HrTimerStats hrtimer_stats;
+
+/* Program the interrupt for the first request. Interrupts must be
+disabled. */
+static void hrtimer_reprogram(void)
+{
+    if (list_is_empty(&hrtimers)) {
+        hrtimer_program(HRTIMER_NONE);
+    } else {
+        hrtimer_program(((HrTimer *) list_get_head(&hrtimers))->deadline);
+    }
+}
+
+void hrtimer_allocate(HrTimer *const timer)
+{
+    SignalNumber signum;
+
+    timer->task = running;
+
+    signum = signal_allocate(-1);
+    assert(-1 != signum);
+    timer->signal = 1 << signum;
+
+    timer->latency = 0;
+    timer->status = TIMER_INITIALIZED;
+}
+
+void hrtimer_free(HrTimer *const timer)
+{
+    timer->task = NULL;
+    signal_free(timer->signal);
+    timer->status = TIMER_INVALID;
+}
+
+void hrtimer_add(HrTimer *const timer)
+{
+    HrTimer *tnode;
+
+    assert(
+      TIMER_INITIALIZED == timer->status ||
+      TIMER_DONE == timer->status ||
+      TIMER_ABORTED == timer->status
+    );
+
+    disable();
+    if (timer->deadline <= timer_get_ns()) {
+        timer->status = TIMER_ABORTED;
+        enable();
+        return;
+    }
+    timer->status = TIMER_ADDED;
+    tnode = (HrTimer *) hrtimers.head.next;
+    while (NULL != tnode->node.next) {
+        if (timer->deadline < tnode->deadline) {
+            break;
+        }
+        tnode = (HrTimer *) tnode->node.next;
+    }
+    /* Before the tail sentinel if at end. */
+    list_insert_before(&tnode->node, &timer->node);
+    if (&timer->node == list_get_head(&hrtimers)) {
+        hrtimer_reprogram();
+    }
+    enable();
+}
+
+void hrtimer_abort(HrTimer *const timer)
+{
+    disable();
+    if (TIMER_ADDED == timer->status) {
+        list_unlink(&timer->node);
+        timer->status = TIMER_ABORTED;
+        hrtimer_reprogram();
+    }
+    enable();
+}
+
+void hrtimer_delay(const uint32_t ns)
+{
+    HrTimer timer;
+
+    hrtimer_allocate(&timer);
+    timer.deadline = timer_get_ns() + ns;
+    hrtimer_add(&timer);
+    if (TIMER_ADDED == timer.status) {
+        signal_wait(timer.signal);
+    } else {
+        /* Already elapsed. */
+    }
+    hrtimer_free(&timer);
+}
+
+void hrtimer_get_stats(HrTimerStats *const stats)
+{
+    disable();
+    *stats = hrtimer_stats;
+    enable();
+}
+
+KERNEL_CODE_PLACEMENT PRIVATE void hrtimer_poll(void)
+{
+    HrTimer *tnode;
+    uint64_t now;
+    uint32_t latency;
+
+    disable();
+    now = timer_get_ns();
+    while (false == list_is_empty(&hrtimers)) {
+        tnode = (HrTimer *) list_get_head(&hrtimers);
+        if (now < tnode->deadline) {
+            break;
+        }
+        list_unlink(&tnode->node);
+        latency = now - tnode->deadline;
+        tnode->latency = latency;
+        tnode->status = TIMER_DONE;
+        if (0 == hrtimer_stats.count || latency < hrtimer_stats.latency_min) {
+            hrtimer_stats.latency_min = latency;
+        }
+        if (hrtimer_stats.latency_max < latency) {
+            hrtimer_stats.latency_max = latency;
+        }
+        hrtimer_stats.latency_sum += latency;
+        hrtimer_stats.count++;
+        signal_send(tnode->task, tnode->signal);
+    }
+    hrtimer_reprogram();
+    enable();
+}
+
+PRIVATE void hrtimer_init(void)
+{
+    list_init(&hrtimers);
+}
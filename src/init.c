@@ -28,18 +28,104 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stddef.h>
 #include <martos/martos.h>
 #include "private.h"
+#include "platform_protos.h"
 #include "default_config.h"
 
-static Task init_task;
-static uint8_t init_task_stack[INIT_TASK_STACK_SIZE];
+/* The round-robin counter is 16 bits. */
+#if QUANTUM < 1 || 0xffff < QUANTUM
+    #error "QUANTUM_US is outside 1..65535 kernel ticks"
+#endif
+
+KERNEL_DATA_PLACEMENT static Task init_task;
+KERNEL_DATA_PLACEMENT static uint8_t init_task_stack[INIT_TASK_STACK_SIZE];
 static void init_task_f(void *user_data);
+#if PARTITION_WINDOWS
+/* The init task has returned from user_init(). */
+KERNEL_DATA_PLACEMENT static bool init_idle;
+#endif
+#if 1 < CPUS
+/* The init task idles on the first core. */
+KERNEL_DATA_PLACEMENT static Task idle_tasks[CPUS - 1];
+KERNEL_DATA_PLACEMENT static uint8_t
+  idle_task_stacks[CPUS - 1][IDLE_TASK_STACK_SIZE];
+/* Task names must be unique: "idle01" and up. */
+static char idle_task_names[CPUS - 1][sizeof "idle00"] = {{0}};
+static void idle_task_f(void *user_data);
+#endif
+
+/* Table of tasks declared with TASK_DECLARE(). Defined by the
+linker script. */
+extern const TaskDeclaration *const _smartos_tasks[];
+extern const TaskDeclaration *const _emartos_tasks[];
+
+/* Make all statically declared tasks ready. They are already
+initialized, except for the stack frame. */
+static void declared_tasks_schedule(void)
+{
+    const TaskDeclaration *const *decl;
+    Task *task;
+
+    for (decl = _smartos_tasks; decl != _emartos_tasks; decl++) {
+        task = (*decl)->task;
+        *task->context.frame = (*decl)->frame;
+        task->state = TASK_READY;
+        ready_enqueue(task);
+    }
+}
+
+#if 1 < CPUS
+/* Install an idle task as the running task of each core but the
+first. */
+static void idle_tasks_init(void)
+{
+    uint_fast8_t cpu;
+    Task *task;
+    char *name;
+
+    for (cpu = 1; cpu < CPUS; cpu++) {
+        task = &idle_tasks[cpu - 1];
+        name = idle_task_names[cpu - 1];
+        name[0] = 'i';
+        name[1] = 'd';
+        name[2] = 'l';
+        name[3] = 'e';
+        name[4] = '0' + cpu / 10;
+        name[5] = '0' + cpu % 10;
+        task_init(
+            task,
+            name,
+            TASK_PRIO_MIN,
+            (void (*const)(void *)) idle_task_f,
+            NULL,
+            &idle_task_stacks[cpu - 1],
+            IDLE_TASK_STACK_SIZE
+        );
+        task->affinity = (CpuSet) 1 << cpu;
+        task->cpu = cpu;
+        task->state = TASK_RUNNING;
+        cpus[cpu].current = task;
+    }
+}
+#endif
 
 TaskContext *martos_pre(void)
 {
+#if 1 < CPUS
+    uint_fast8_t cpu;
+
+    for (cpu = 0; cpu < CPUS; cpu++) {
+        list_init(&cpus[cpu].queue);
+        cpus[cpu].slice = QUANTUM;
+    }
+#else
     list_init(&ready);
+    elapsed = QUANTUM;
+#endif
     list_init(&waiting);
     id_nestcnt = -1;
-    elapsed = QUANTUM;
+#if PARTITION_WINDOWS
+    partition_init();
+#endif
 
     task_init(
         &init_task,
@@ -50,24 +136,62 @@ TaskContext *martos_pre(void)
         &init_task_stack,
         INIT_TASK_STACK_SIZE
     );
+    init_task.affinity = 1;
 
     /* Verify init task parameters. */
     task_verify(&init_task);
     /* Install it. */
     init_task.state = TASK_RUNNING;
     running = &init_task;
+#if 1 < CPUS
+    idle_tasks_init();
+#endif
+
     return &init_task.context;
 }
 
 static void init_task_f(void *user_data)
 {
+    hrtimer_init();
     timer_init();
+#if TIMER_SERVICE
+    timer_service_init();
+#endif
+    /* The declared tasks may use the timers, and with more than
+    one core they start as soon as they are ready. On one core
+    they wait until the init task has lowered its priority. */
+    disable();
+    declared_tasks_schedule();
+    enable();
     task_set_prio(&init_task, TASK_PRIO_MIN);
     user_init();
+#if PARTITION_WINDOWS
+    disable();
+    init_idle = true;
+    /* Ready background tasks may now run. */
+    reschedule();
+    enable();
+#endif
+    while(1) {
+        cpu_idle();
+    }
+}
+
+#if PARTITION_WINDOWS
+PRIVATE bool task_is_idle(Task *const task)
+{
+    return init_idle && &init_task == task;
+}
+#endif
+
+#if 1 < CPUS
+static void idle_task_f(void *user_data)
+{
     while(1) {
-        ;
+        cpu_idle();
     }
 }
+#endif
 
 void user_halt(void)
 {
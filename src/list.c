@@ -27,82 +27,13 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stddef.h>
 #include <string.h>
-#include <assert.h>
 #include <martos/martos.h>
+#include "default_config.h"
 
-void list_unlink(Node *const node)
-{
-    node->prev->next = node->next;
-    node->next->prev = node->prev;
-}
-
-void list_init(List *const list)
-{
-    list->head.next = &(list->tail);
-    list->head.prev = NULL;
-    list->tail.next = NULL;
-    list->tail.prev = &(list->head);
-}
+/* The rest of the list primitives are static inline in
+martos/list.h. */
 
-bool list_is_empty(List *const list)
-{
-    if (&list->head == list->tail.prev) {
-        return true;
-    } else {
-        return false;
-    }
-}
-
-void list_add_tail(List *const list, Node *const node)
-{
-    node->next = (Node *) &list->tail.next;
-    node->prev = (Node *) list->tail.prev;
-    list->tail.prev->next = (MinNode *) node;
-    list->tail.prev = (MinNode *) node;
-}
-
-Node *list_rem_head(List *const list)
-{
-    Node *node;
-
-    node = list_get_head(list);
-
-    if (NULL != node) {
-        list_unlink(node);
-    }
-    return node;
-}
-
-Node *list_get_head(List *const list)
-{
-    if (true == list_is_empty(list)) {
-        return NULL;
-    } else {
-        return (Node *) list->head.next;
-    }
-}
-
-void list_insert(List *const list, Node *const node, Node *const prev)
-{
-    if (NULL == prev) {
-        /* No prev node given, fall back on list_add_head(). */
-        assert(true);
-        #if 0
-        list_add_head(list, node);
-        #endif
-    } else if (NULL != prev->next) {
-        /* Normal node */
-        node->next = prev->next;
-        node->prev = prev;
-        prev->next->prev = node;
-        prev->next = node;
-    } else {
-        /* Last node */
-        list_add_tail(list, node);
-    }
-}
-
-void list_enqueue(List *const list, Node *const node)
+KERNEL_CODE_PLACEMENT void list_enqueue(List *const list, Node *const node)
 {
     Node *nextnode;
 
@@ -113,23 +44,48 @@ void list_enqueue(List *const list, Node *const node)
         }
         nextnode = nextnode->next;
     }
-    node->next = nextnode;
-    node->prev = nextnode->prev;
-    nextnode->prev->next = node;
-    nextnode->prev = node;
+    list_insert_before(nextnode, node);
 }
 
 Node *list_find(List *const start, char *const name)
 {
     Node *nextnode;
 
-    nextnode = (Node *) start->head.next;
-    while (NULL != nextnode->next) {
+    LIST_FOR_EACH(nextnode, start) {
         if (0 == strcmp(nextnode->name, name)) {
             return nextnode;
         }
-        nextnode = nextnode->next;
     }
     return NULL;
 }
 
+void plist_add(PrioList *const list, PrioNode *const node)
+{
+    MinNode *group;
+    PrioNode *first = NULL;
+
+    /* Find the first priority group with priority lower than
+    or equal to node. */
+    LIST_FOR_EACH(group, &list->prios) {
+        first = LIST_CONTAINER(group, PrioNode, prio_node);
+        if (first->prio <= node->prio) {
+            break;
+        }
+    }
+
+    if (NULL != group->next && first->prio == node->prio) {
+        /* Join the group, last. That is before the first node
+        of next group. */
+        group = group->next;
+        node->prio_node.next = NULL;
+    } else {
+        /* Start a new group before the found one. */
+        list_insert_before((Node *) group, (Node *) &node->prio_node);
+    }
+    if (NULL != group->next) {
+        group = &LIST_CONTAINER(group, PrioNode, prio_node)->node;
+    } else {
+        group = &list->nodes.tail;
+    }
+    list_insert_before((Node *) group, (Node *) &node->node);
+}
@@ -49,6 +49,23 @@ To use it, define ONE_NAMESPACE=1. */
 #include "init.c"
 #include "task.c"
 #include "semaphore.c"
+#include "rwlock.c"
+#include "condvar.c"
+#include "barrier.c"
 #include "msgport.c"
+#include "queue.c"
+#include "stream.c"
+#include "topic.c"
 #include "timer.c"
+#include "hrtimer.c"
+#if TIMER_SERVICE
+#include "timer_service.c"
+#endif
+#include "periodic.c"
+#if PARTITION_WINDOWS
+#include "partition.c"
+#endif
+#if FAIR_SHARE
+#include "fair.c"
+#endif
 
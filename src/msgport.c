@@ -33,6 +33,7 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <assert.h>
 #include <martos/martos.h>
 #include "private.h"
+#include "default_config.h"
 
 void msgport_init(MsgPort *const port)
 {
@@ -61,17 +62,50 @@ Message *msgport_wait(MsgPort *const port)
     return msg;
 }
 
+Message *msgport_wait_timeout(MsgPort *const port, const Ticks timeout)
+{
+    Message *msg;
+
+    disable();
+    if (list_is_empty(&port->message_list)) {
+        /* One timeout for all wakeups. */
+        task_timeout_start(timeout);
+        while (list_is_empty(&port->message_list) &&
+          0 != signal_wait(port->signal)) {
+            ;
+        }
+        task_timeout_stop();
+    }
+    msg = (Message *) list_get_head(&port->message_list);
+    enable();
+    return msg;
+}
+
+Message *msgport_try_wait(MsgPort *const port)
+{
+    Message *msg;
+
+    disable();
+    msg = (Message *) list_get_head(&port->message_list);
+    enable();
+    return msg;
+}
+
 Message *msgport_get(MsgPort *const port)
 {
     Message *msg;
 
     disable();
     msg = (Message *) list_rem_head(&port->message_list);
+    if (NULL != msg) {
+        /* Mark it as taken, see timer_add(). */
+        msg->node.next = NULL;
+    }
     enable();
     return msg;
 }
 
-void msgport_send(MsgPort *const port, Message *const message)
+KERNEL_CODE_PLACEMENT void msgport_send(MsgPort *const port, Message *const message)
 {
     /* TODO: Check consistency of port->signal. */
     /* Assume that the port does not disappear, for example
@@ -111,3 +145,14 @@ void msgport_reply(Message *const message)
     msgport_send(port, message);
 }
 
+PRIVATE bool msgport_queued(MsgPort *const port, Message *const message)
+{
+    MinNode *node;
+
+    LIST_FOR_EACH(node, &port->message_list) {
+        if (&message->node == node) {
+            return true;
+        }
+    }
+    return false;
+}
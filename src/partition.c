@@ -0,0 +1,179 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <assert.h>
+#include <martos/martos.h>
+#include "private.h"
+#include "platform_protos.h"
+#include "default_config.h"
+
+/* Time partitioned scheduling. The major frame is a static
+table of windows, partition_schedule[], which is stepped
+through by the timer tick. A task is eligible for execution if
+it belongs to the system partition or to a partition enabled by
+the active window. */
+
+/* Index of active window in partition_schedule. */
+static uint_fast8_t active;
+/* Ticks left of active window. */
+static Ticks remaining;
+static uint32_t overruns[PARTITION_WINDOWS];
+
+static bool partition_member(Task *const task, const PartitionSet set)
+{
+    return 0 != (set & ((PartitionSet) 1 << task->partition));
+}
+
+PRIVATE void partition_init(void)
+{
+    uint_fast8_t i;
+
+    for (i = 0; i < PARTITION_WINDOWS; i++) {
+        assert(0 < partition_schedule[i].length);
+        overruns[i] = 0;
+    }
+    active = 0;
+    remaining = partition_schedule[0].length;
+}
+
+static bool partition_eligible(Task *const task)
+{
+    if (0 == task->partition) {
+        return true;
+    }
+    return partition_member(task, partition_schedule[active].partitions);
+}
+
+/* Return true if task may run on idle time donated by the
+active window. */
+static bool partition_background(Task *const task)
+{
+    return 0 != PARTITION_BACKGROUND &&
+      PARTITION_BACKGROUND == task->partition;
+}
+
+PRIVATE bool partition_preempts(Task *const task)
+{
+    if (task_is_idle(running)) {
+        if (false == partition_eligible(task)) {
+            /* Nothing eligible is ready, or it would run instead
+            of idle, so idle time is donated to background. */
+            return partition_background(task);
+        }
+        return running->node.prio < task->node.prio;
+    }
+    if (false == partition_eligible(running)) {
+        /* Running task has been donated idle time of the
+        active window, which it must give back to any eligible
+        task. */
+        if (partition_eligible(task)) {
+            return true;
+        }
+        return partition_background(task) &&
+          running->node.prio < task->node.prio;
+    }
+    if (false == partition_eligible(task)) {
+        return false;
+    }
+    return running->node.prio < task->node.prio;
+}
+
+PRIVATE Task *partition_next(void)
+{
+    /* Ready list is in priority order so the first eligible
+    task is the one to run. The window donates its idle time
+    to the background partition, so background tasks are only
+    chosen if no eligible task but idle is ready. */
+    Task *task;
+    Task *background = NULL;
+    Task *idle = NULL;
+
+    task = (Task *) ready.head.next;
+    while (NULL != task->node.next) {
+        if (task_is_idle(task)) {
+            idle = task;
+        } else if (partition_eligible(task)) {
+            break;
+        } else if (NULL == background && partition_background(task)) {
+            background = task;
+        }
+        task = (Task *) task->node.next;
+    }
+    if (NULL == task->node.next) {
+        task = NULL != background ? background : idle;
+    }
+    /* The idle task is always ready if not running. */
+    assert(NULL != task);
+    list_unlink((Node *) task);
+    return task;
+}
+
+/* Return true if any task in set is ready or running. */
+static bool partition_busy(const PartitionSet set)
+{
+    Task *task;
+
+    if (TASK_RUNNING == running->state &&
+      0 != running->partition &&
+      partition_member(running, set)) {
+        return true;
+    }
+    task = (Task *) ready.head.next;
+    while (NULL != task->node.next) {
+        if (0 != task->partition && partition_member(task, set)) {
+            return true;
+        }
+        task = (Task *) task->node.next;
+    }
+    return false;
+}
+
+PRIVATE void partition_tick(void)
+{
+    disable();
+    remaining--;
+    if (0 == remaining) {
+        if (partition_busy(partition_schedule[active].partitions)) {
+            overruns[active]++;
+        }
+        active++;
+        if (PARTITION_WINDOWS == active) {
+            active = 0;
+        }
+        remaining = partition_schedule[active].length;
+        /* Let the scheduler switch to the new window. */
+        reschedule();
+    }
+    enable();
+}
+
+uint32_t partition_overruns(const uint_fast8_t window)
+{
+    assert(window < PARTITION_WINDOWS);
+    return overruns[window];
+}
@@ -0,0 +1,169 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <assert.h>
+#include <martos/martos.h>
+#include "private.h"
+#include "default_config.h"
+
+/* Periodic tasks. Each job is released by a TIMER_ALARM at
+release + period so that the phase of the first release is
+kept. */
+
+#if PERIODIC_ADMISSION
+/* Rate monotonic utilization bound n * (2^(1/n) - 1) for n
+tasks, in units of 1/1000. */
+static const uint16_t rm_bound[] = {
+    1000, 828, 779, 756, 743, 734, 728, 724, 720, 717
+};
+static const uint16_t rm_bound_limit = 693;
+
+/* Sum of utilization of admitted tasks, in units of 1/1000. */
+static uint32_t utilization;
+/* Number of admitted tasks with declared wcet. */
+static uint_fast16_t admitted;
+
+static bool admission_test(const Ticks period, const Ticks wcet)
+{
+    uint32_t u;
+    uint32_t bound;
+    bool ok;
+
+    if (0 == wcet) {
+        /* Nothing declared, nothing to test. */
+        return true;
+    }
+    /* Round up so we never admit too much. */
+    u = ((uint32_t) wcet * 1000 + period - 1) / period;
+    disable();
+    if (admitted < sizeof rm_bound / sizeof rm_bound[0]) {
+        bound = rm_bound[admitted];
+    } else {
+        bound = rm_bound_limit;
+    }
+    ok = utilization + u <= bound;
+    if (ok) {
+        utilization += u;
+        admitted++;
+    }
+    enable();
+    return ok;
+}
+#endif
+
+bool task_set_periodic(
+    Task *const task,
+    Periodic *const periodic,
+    const Ticks period,
+    const Ticks deadline,
+    const Ticks wcet
+)
+{
+    assert(TASK_INITIALIZED == task->state);
+    assert(0 < period);
+    assert(0 < deadline && deadline <= period);
+    assert(wcet <= deadline);
+
+#if PERIODIC_ADMISSION
+    /* The test is made with the deadline as period to be on
+    the safe side for deadline < period. */
+    if (false == admission_test(deadline, wcet)) {
+        return false;
+    }
+#endif
+    periodic->period = period;
+    periodic->deadline = deadline;
+    periodic->wcet = wcet;
+    periodic->release = timer_get_clock();
+    /* Allocated by the task itself on first wait. */
+    periodic->timer.signal = 0;
+    periodic->jobs = 0;
+    periodic->overruns = 0;
+    periodic->deadline_misses = 0;
+    periodic->jitter_min = (Ticks) -1;
+    periodic->jitter_max = 0;
+    periodic->response_min = (Ticks) -1;
+    periodic->response_max = 0;
+    periodic->response_sum = 0;
+    task->periodic = periodic;
+    return true;
+}
+
+void task_wait_period(void)
+{
+    Periodic *const periodic = running->periodic;
+    Ticks now;
+    Ticks response;
+    Ticks jitter;
+
+    assert(NULL != periodic);
+    if (0 == periodic->timer.signal) {
+        /* Signal must be allocated in the context of the
+        periodic task. */
+        timer_allocate(&periodic->timer);
+        periodic->timer.op = TIMER_ALARM;
+    }
+
+    /* Book keeping for the completed job. */
+    now = timer_get_clock();
+    response = now - periodic->release;
+    periodic->jobs++;
+    periodic->response_sum += response;
+    if (response < periodic->response_min) {
+        periodic->response_min = response;
+    }
+    if (periodic->response_max < response) {
+        periodic->response_max = response;
+    }
+    if (periodic->deadline < response) {
+        periodic->deadline_misses++;
+    }
+
+    periodic->release += periodic->period;
+    if (periodic->period <= response) {
+        /* Next release has already passed. Start the job
+        immediately so that we can catch up. */
+        periodic->overruns++;
+    } else {
+        periodic->timer.tick = periodic->release;
+        timer_add(&periodic->timer);
+        if (TIMER_ADDED == periodic->timer.status) {
+            signal_wait(periodic->timer.signal);
+        } else {
+            /* Released while adding. */
+        }
+    }
+
+    jitter = timer_get_clock() - periodic->release;
+    if (jitter < periodic->jitter_min) {
+        periodic->jitter_min = jitter;
+    }
+    if (periodic->jitter_max < jitter) {
+        periodic->jitter_max = jitter;
+    }
+}
@@ -49,5 +49,31 @@ PRIVATE void reschedule(void);
 
 PRIVATE void timer_init_platform(void);
 
+/* No HrTimer deadline. */
+#define HRTIMER_NONE UINT64_MAX
+
+/* Request a call to hrtimer_poll() when timer_get_ns() reaches
+deadline, replacing any earlier request. HRTIMER_NONE cancels.
+Called with interrupts disabled. */
+PRIVATE void hrtimer_program(const uint64_t deadline);
+
+/* Called repeatedly by idle tasks. May wait for an interrupt. */
+PRIVATE void cpu_idle(void);
+
+#if 1 < CPUS
+/* Request a context switch on another core. */
+PRIVATE void cpu_reschedule(const uint_fast8_t cpu);
+#endif
+
+/* platform.h shall also define the atomic counter operations
+platform_atomic_add_min() and platform_atomic_add(), and the
+memory barrier platform_barrier(), as static inline functions.
+They are used without disable(). */
+
+#if FAIR_SHARE
+/* Free running processor cycle counter. */
+PRIVATE uint32_t platform_cycles(void);
+#endif
+
 #endif
 
@@ -28,6 +28,25 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef PRIVATE_H
 #define PRIVATE_H
 
+#include "default_config.h"
+
+#if 1 < CPUS
+/* Scheduler state of a processor core. */
+typedef struct {
+    /* The task running on the core. */
+    Task *current;
+    /* Tasks ready for execution on the core. */
+    List queue;
+    /* Number of ticks left for current in round-robin. */
+    uint_fast16_t slice;
+} Cpu;
+
+/* The scheduler state of the executing core. */
+#define running (cpus[cpu_id()].current)
+#define ready (cpus[cpu_id()].queue)
+#define elapsed (cpus[cpu_id()].slice)
+#endif
+
 /* Define MARTOS_NAMESPACE to compile all C files of the kernel
 in a single compilation unit. */
 #ifdef MARTOS_NAMESPACE
@@ -37,14 +56,18 @@ in a single compilation unit. */
 /* Interrupt disable nest count. */
 extern NestCnt id_nestcnt;
 
+#if 1 < CPUS
+extern Cpu cpus[CPUS];
+#else
 /* Number of ticks left for task in round-robin. */
-extern uint_fast8_t elapsed;
+extern uint_fast16_t elapsed;
 
 /* The currently running task. */
 extern Task *running;
 
 /* All ready tasks must be on the waiting queue. */
 extern List ready;
+#endif
 
 /* All non-ready tasks must be on the waiting queue. */
 /* FIXME: What about tasks waiting on semaphores? */
@@ -56,6 +79,53 @@ extern List waiting;
 PRIVATE void task_verify(Task *const task);
 PRIVATE void timer_init(void);
 PRIVATE void timer_poll(void);
+#if TIMER_SERVICE
+PRIVATE void timer_service_init(void);
+/* Queue an expired callback request to the timer service.
+Interrupts must be disabled. */
+PRIVATE void timer_service_post(Timer *const timer);
+#endif
+PRIVATE void hrtimer_init(void);
+/* Expire the HrTimer requests whose deadline has passed. Called
+from the interrupt requested with hrtimer_program(). */
+PRIVATE void hrtimer_poll(void);
 PRIVATE TaskContext *martos_pre(void);
+/* Remove and return the task to switch in from ready. */
+PRIVATE Task *task_next(void);
+/* Add task to ready in scheduling order. */
+PRIVATE void ready_enqueue(Task *const task);
+/* Wait queue operations. The caller must have disabled
+interrupts. The waiter and signal fields of req must be set
+before it is enqueued. */
+PRIVATE void request_enqueue(PrioList *const queue, SemaphoreRequest *const req);
+PRIVATE void request_remove(SemaphoreRequest *const req);
+PRIVATE SemaphoreRequest *request_dequeue(PrioList *const queue);
+/* Return true if message is in the queue of port, not yet taken
+by its owner. The caller must have disabled interrupts. */
+PRIVATE bool msgport_queued(MsgPort *const port, Message *const message);
+/* Arm the timeout of the running task. A blocking signal_wait()
+returns 0 when it expires. A timeout of 0 has already expired.
+The caller must have disabled interrupts. */
+PRIVATE void task_timeout_start(const Ticks timeout);
+PRIVATE void task_timeout_stop(void);
+/* Called by the timer tick when the timeout of task expires. */
+PRIVATE void task_timeout(Task *const task);
+#if PARTITION_WINDOWS
+/* Return true if task is the init task idling after user_init(). */
+PRIVATE bool task_is_idle(Task *const task);
+PRIVATE void partition_init(void);
+PRIVATE void partition_tick(void);
+PRIVATE Task *partition_next(void);
+/* Return true if task shall preempt the running task. */
+PRIVATE bool partition_preempts(Task *const task);
+#endif
+#if FAIR_SHARE
+PRIVATE void fair_init(void);
+/* Charge the cycles since the last call to task. */
+PRIVATE void fair_charge(Task *const task);
+/* Limit the credit a task gains while not ready. */
+PRIVATE void fair_wakeup(Task *const task);
+PRIVATE void fair_enqueue(Task *const task);
+#endif
 
 #endif
@@ -0,0 +1,234 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include <martos/martos.h>
+#include "private.h"
+#include "default_config.h"
+
+/* Bounded queue. Items are copied in and out of the ring with
+interrupts disabled, so the non-blocking calls may be made from
+interrupt context. A task which waits for space or for an item is
+queued with a SemaphoreRequest and checks again when woken, so
+one wakeup is made per item or free slot. */
+
+void queue_init(
+    Queue *const queue,
+    void *const buffer,
+    const uint32_t item_size,
+    const uint32_t capacity
+)
+{
+    assert(NULL != buffer);
+    assert(0 < item_size && 0 < capacity);
+    queue->buffer = buffer;
+    queue->item_size = item_size;
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    plist_init(&queue->senders);
+    plist_init(&queue->receivers);
+}
+
+/* Wait on waiters until woken. Return false only if the timeout
+of the task expired, so the caller checks again and blocks anew
+after a stray SIGF_SINGLE. Interrupts must be disabled. */
+static bool queue_block(PrioList *const waiters)
+{
+    SemaphoreRequest req;
+    Signals rcvd;
+
+    req.signal = SIGF_SINGLE;
+    req.waiter = running;
+    request_enqueue(waiters, &req);
+    rcvd = signal_wait(SIGF_SINGLE);
+    if (NULL != req.queue) {
+        /* Timed out, or woken by someone else. */
+        request_remove(&req);
+    }
+    return 0 != rcvd;
+}
+
+/* Wake the first task in waiters. */
+KERNEL_CODE_PLACEMENT static void queue_wake(PrioList *const waiters)
+{
+    SemaphoreRequest *req;
+
+    req = request_dequeue(waiters);
+    if (NULL != req) {
+        signal_send(req->waiter, req->signal);
+    }
+}
+
+KERNEL_CODE_PLACEMENT static void queue_put(Queue *const queue, const void *const item)
+{
+    uint32_t tail;
+
+    tail = queue->head + queue->count;
+    if (queue->capacity <= tail) {
+        tail -= queue->capacity;
+    }
+    memcpy(queue->buffer + tail * queue->item_size, item,
+      queue->item_size);
+    queue->count++;
+    queue_wake(&queue->receivers);
+}
+
+KERNEL_CODE_PLACEMENT static void queue_take(Queue *const queue, void *const item)
+{
+    memcpy(item, queue->buffer + queue->head * queue->item_size,
+      queue->item_size);
+    queue->head++;
+    if (queue->capacity == queue->head) {
+        queue->head = 0;
+    }
+    queue->count--;
+    queue_wake(&queue->senders);
+}
+
+/* Send, waiting at most timeout ticks if timed. */
+static bool queue_send_wait(
+    Queue *const queue,
+    const void *const item,
+    const bool timed,
+    const Ticks timeout
+)
+{
+    bool sent;
+
+    disable();
+    if (queue->capacity == queue->count) {
+        if (timed) {
+            task_timeout_start(timeout);
+        }
+        while (queue->capacity == queue->count &&
+          queue_block(&queue->senders)) {
+            ;
+        }
+        if (timed) {
+            task_timeout_stop();
+        }
+    }
+    sent = queue->count < queue->capacity;
+    if (sent) {
+        queue_put(queue, item);
+    }
+    enable();
+    return sent;
+}
+
+/* Receive, waiting at most timeout ticks if timed. */
+static bool queue_receive_wait(
+    Queue *const queue,
+    void *const item,
+    const bool timed,
+    const Ticks timeout
+)
+{
+    bool received;
+
+    disable();
+    if (0 == queue->count) {
+        if (timed) {
+            task_timeout_start(timeout);
+        }
+        while (0 == queue->count && queue_block(&queue->receivers)) {
+            ;
+        }
+        if (timed) {
+            task_timeout_stop();
+        }
+    }
+    received = 0 < queue->count;
+    if (received) {
+        queue_take(queue, item);
+    }
+    enable();
+    return received;
+}
+
+void queue_send(Queue *const queue, const void *const item)
+{
+    queue_send_wait(queue, item, false, 0);
+}
+
+bool queue_send_timeout(
+    Queue *const queue,
+    const void *const item,
+    const Ticks timeout
+)
+{
+    return queue_send_wait(queue, item, true, timeout);
+}
+
+KERNEL_CODE_PLACEMENT bool queue_try_send(
+    Queue *const queue,
+    const void *const item
+)
+{
+    bool sent;
+
+    disable();
+    sent = queue->count < queue->capacity;
+    if (sent) {
+        queue_put(queue, item);
+    }
+    enable();
+    return sent;
+}
+
+void queue_receive(Queue *const queue, void *const item)
+{
+    queue_receive_wait(queue, item, false, 0);
+}
+
+bool queue_receive_timeout(
+    Queue *const queue,
+    void *const item,
+    const Ticks timeout
+)
+{
+    return queue_receive_wait(queue, item, true, timeout);
+}
+
+KERNEL_CODE_PLACEMENT bool queue_try_receive(
+    Queue *const queue,
+    void *const item
+)
+{
+    bool received;
+
+    disable();
+    received = 0 < queue->count;
+    if (received) {
+        queue_take(queue, item);
+    }
+    enable();
+    return received;
+}
@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <assert.h>
+#include <martos/martos.h>
+#include "private.h"
+
+/* Reader-writer lock with writer preference. Readers only update
+count while it is not negative, which is while no writer holds
+or waits for the lock. Everything else, including the bias of
+the writer, is done with interrupts disabled, and waiting tasks
+are queued with SemaphoreRequests like on a Semaphore. A task is
+woken with the lock already taken on its behalf. */
+
+void rwlock_init(RwLock *const lock)
+{
+    lock->count = 0;
+    plist_init(&lock->readers);
+    plist_init(&lock->writers);
+    lock->writer = false;
+}
+
+/* Queue a request of the running task and wait until it is
+granted, that is dequeued, whatever signal woke it. Interrupts
+must be disabled. */
+static void rwlock_block(PrioList *const queue)
+{
+    SemaphoreRequest req;
+
+    req.signal = SIGF_SINGLE;
+    req.waiter = running;
+    request_enqueue(queue, &req);
+    while (NULL != req.queue) {
+        signal_wait(SIGF_SINGLE);
+    }
+}
+
+/* Hand the lock to the first waiting writer. */
+static void rwlock_grant_writer(RwLock *const lock)
+{
+    SemaphoreRequest *req;
+
+    req = request_dequeue(&lock->writers);
+    assert(NULL != req);
+    lock->writer = true;
+    signal_send(req->waiter, req->signal);
+}
+
+void rwlock_read_lock(RwLock *const lock)
+{
+    if (platform_atomic_add_min(&lock->count, 1, 1)) {
+        return;
+    }
+    disable();
+    if (0 <= lock->count) {
+        /* The writer left before we disabled. */
+        platform_atomic_add(&lock->count, 1);
+    } else {
+        rwlock_block(&lock->readers);
+    }
+    enable();
+}
+
+void rwlock_read_unlock(RwLock *const lock)
+{
+    int32_t count;
+
+    if (platform_atomic_add_min(&lock->count, -1, 0)) {
+        return;
+    }
+    disable();
+    count = platform_atomic_add(&lock->count, -1);
+    assert(-RWLOCK_WRITER <= count);
+    if (-RWLOCK_WRITER == count) {
+        /* The last reader lets the waiting writer in. */
+        rwlock_grant_writer(lock);
+    }
+    enable();
+}
+
+void rwlock_write_lock(RwLock *const lock)
+{
+    disable();
+    if (0 <= lock->count &&
+      -RWLOCK_WRITER == platform_atomic_add(&lock->count, -RWLOCK_WRITER)) {
+        /* There were no readers. */
+        lock->writer = true;
+    } else {
+        /* Readers are held back by the bias. The last of the
+        current ones, or the writer before us, grants the lock. */
+        rwlock_block(&lock->writers);
+    }
+    enable();
+}
+
+void rwlock_write_unlock(RwLock *const lock)
+{
+    SemaphoreRequest *req;
+
+    disable();
+    assert(lock->writer);
+    assert(-RWLOCK_WRITER == lock->count);
+    lock->writer = false;
+    if (false == plist_is_empty(&lock->writers)) {
+        /* Writer preference, the bias is kept. */
+        rwlock_grant_writer(lock);
+    } else {
+        platform_atomic_add(&lock->count, RWLOCK_WRITER);
+        while (NULL != (req = request_dequeue(&lock->readers))) {
+            platform_atomic_add(&lock->count, 1);
+            signal_send(req->waiter, req->signal);
+        }
+    }
+    enable();
+}
@@ -40,21 +40,36 @@ becomes a task private handle for the semaphore. */
 void sem_init(Semaphore *const sem, const SemaphoreCount count)
 {
     sem->count = count;
-    list_init(&sem->req_queue);
+    plist_init(&sem->req_queue);
 }
 
+/* The count is changed atomically everywhere. A count which goes
+below zero, and the requests, are only handled with interrupts
+disabled, so the fast paths only take a free semaphore or give
+one back when nobody waits. */
+
 void sem_wait(Semaphore *const sem)
 {
     SemaphoreRequest req;
+
+    if (platform_atomic_add_min(&sem->count, -1, 0)) {
+        /* Uncontended. */
+        return;
+    }
     req.signal = SIGF_SINGLE;
     req.waiter = running;
+    disable();
     if (true == sem_add_request(sem, &req)) {
         /* Request added, we have to wait for semaphore to be
-        released. */
-        signal_wait(SIGF_SINGLE);
+        released. It is ours when sem_signal() has dequeued the
+        request, whatever signal woke us. */
+        while (NULL != req.queue) {
+            signal_wait(SIGF_SINGLE);
+        }
     } else {
         /* We have got it. */
     }
+    enable();
 }
 
 bool sem_add_request(Semaphore *const sem, SemaphoreRequest *const req)
@@ -62,11 +77,10 @@ bool sem_add_request(Semaphore *const sem, SemaphoreRequest *const req)
     /* We could temporarily set a very high priority instead
     of disable(). */
     disable();
-    sem->count--;
-    if (sem->count < 0) {
+    if (platform_atomic_add(&sem->count, -1) < 0) {
         /* Someone has the semaphore, and it is not us. Add
         our request to the semaphores queue, but do not wait. */
-        list_add_tail(&sem->req_queue, (Node *) req);
+        request_enqueue(&sem->req_queue, req);
         enable();
         return true;
     } else {
@@ -76,15 +90,71 @@ bool sem_add_request(Semaphore *const sem, SemaphoreRequest *const req)
     }
 }
 
+bool sem_cancel_request(Semaphore *const sem, SemaphoreRequest *const req)
+{
+    bool queued;
+
+    disable();
+    queued = NULL != req->queue;
+    if (queued) {
+        assert(&sem->req_queue == req->queue);
+        request_remove(req);
+        /* Give back the count taken by sem_add_request(). */
+        platform_atomic_add(&sem->count, 1);
+    } else {
+        /* Dequeued by sem_signal(), so we hold the semaphore. */
+    }
+    enable();
+    return queued;
+}
+
+bool sem_wait_timeout(Semaphore *const sem, const Ticks timeout)
+{
+    SemaphoreRequest req;
+
+    if (platform_atomic_add_min(&sem->count, -1, 0)) {
+        return true;
+    }
+    /* The request is only linked to the stack while this
+    function runs. */
+    req.signal = SIGF_SINGLE;
+    req.waiter = running;
+    disable();
+    if (true == sem_add_request(sem, &req)) {
+        /* Wait again if woken by someone else. No signal means
+        the timeout expired. */
+        task_timeout_start(timeout);
+        while (NULL != req.queue && 0 != signal_wait(SIGF_SINGLE)) {
+            ;
+        }
+        task_timeout_stop();
+        if (true == sem_cancel_request(sem, &req)) {
+            enable();
+            return false;
+        }
+    }
+    enable();
+    return true;
+}
+
+bool sem_try_wait(Semaphore *const sem)
+{
+    return platform_atomic_add_min(&sem->count, -1, 0);
+}
+
 void sem_signal(Semaphore *const sem)
 {
     SemaphoreRequest *req;
 
+    if (platform_atomic_add_min(&sem->count, 1, 1)) {
+        /* Nobody waits. */
+        return;
+    }
     disable();
-    sem->count++;
-    if (sem->count < 0) {
+    if (platform_atomic_add(&sem->count, 1) <= 0) {
         /* There are pending requests in the queue. */
-        req = (SemaphoreRequest *) list_rem_head(&sem->req_queue);
+        /* Wake the waiter with highest priority. */
+        req = request_dequeue(&sem->req_queue);
         assert(NULL != req);
         assert(running != req->waiter);
         assert(0 != req->signal);
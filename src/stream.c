@@ -0,0 +1,166 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include <martos/martos.h>
+#include "private.h"
+#include "default_config.h"
+
+/* Stream buffer. The writer only moves head and the reader only
+moves tail, so no lock is needed between them. The fences order
+the bytes before the count which publishes them, and order the
+reader's wanted against head, so that either the writer sees the
+reader waiting or the reader sees the bytes. */
+
+void stream_init(
+    StreamBuffer *const stream,
+    void *const buffer,
+    const uint32_t size
+)
+{
+    SignalNumber signum;
+
+    assert(NULL != buffer);
+    assert(0 < size && 0 == (size & (size - 1)));
+    assert(size <= (UINT32_C(1) << 31));
+    signum = signal_allocate(-1);
+    assert(-1 != signum);
+    stream->buffer = buffer;
+    stream->size = size;
+    stream->head = 0;
+    stream->tail = 0;
+    stream->task = running;
+    stream->signal = 1 << signum;
+    stream->wanted = 0;
+}
+
+KERNEL_CODE_PLACEMENT uint32_t stream_write(
+    StreamBuffer *const stream,
+    const void *const data,
+    const uint32_t length
+)
+{
+    const uint32_t head = stream->head;
+    uint32_t count;
+    uint32_t index;
+    uint32_t first;
+    uint32_t wanted;
+
+    count = stream->size - (head - stream->tail);
+    if (length < count) {
+        count = length;
+    }
+    index = head & (stream->size - 1);
+    first = stream->size - index;
+    if (count < first) {
+        first = count;
+    }
+    memcpy(stream->buffer + index, data, first);
+    memcpy(stream->buffer, (const uint8_t *) data + first, count - first);
+    platform_barrier();
+    stream->head = head + count;
+    platform_barrier();
+
+    wanted = stream->wanted;
+    if (0 != wanted && wanted <= head + count - stream->tail) {
+        signal_send(stream->task, stream->signal);
+    }
+    return count;
+}
+
+/* Wait for count bytes, at most timeout ticks if timed. */
+static uint32_t stream_block(
+    StreamBuffer *const stream,
+    const uint32_t count,
+    const bool timed,
+    const Ticks timeout
+)
+{
+    uint32_t available;
+
+    assert(running == stream->task);
+    assert(0 < count && count <= stream->size);
+    available = stream_available(stream);
+    if (count <= available) {
+        return available;
+    }
+    disable();
+    if (timed) {
+        task_timeout_start(timeout);
+    }
+    stream->wanted = count;
+    platform_barrier();
+    /* A signal left from an earlier wait only makes one more
+    check. */
+    while ((available = stream_available(stream)) < count &&
+      0 != signal_wait(stream->signal)) {
+        ;
+    }
+    stream->wanted = 0;
+    if (timed) {
+        task_timeout_stop();
+    }
+    enable();
+    return stream_available(stream);
+}
+
+uint32_t stream_wait(StreamBuffer *const stream, const uint32_t count)
+{
+    return stream_block(stream, count, false, 0);
+}
+
+uint32_t stream_wait_timeout(
+    StreamBuffer *const stream,
+    const uint32_t count,
+    const Ticks timeout
+)
+{
+    return stream_block(stream, count, true, timeout);
+}
+
+uint32_t stream_peek(StreamBuffer *const stream, const uint8_t **const data)
+{
+    const uint32_t index = stream->tail & (stream->size - 1);
+    uint32_t count;
+
+    count = stream_available(stream);
+    platform_barrier();
+    if (stream->size - index < count) {
+        count = stream->size - index;
+    }
+    *data = stream->buffer + index;
+    return count;
+}
+
+void stream_consume(StreamBuffer *const stream, const uint32_t count)
+{
+    assert(count <= stream_available(stream));
+    platform_barrier();
+    stream->tail += count;
+}
@@ -31,6 +31,17 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <martos/martos.h>
 #include "private.h"
 #include "platform_protos.h"
+#include "default_config.h"
+
+/* CPUS_WIDTH */
+#if 32 < CPUS
+    #error "CPUS is larger than CpuSet"
+#endif
+#if 1 < CPUS && (PARTITION_WINDOWS || FAIR_SHARE)
+    #error "Time partitions and fair share need CPUS = 1"
+#endif
+
+static bool task_preempts(Task *const task);
 
 void task_init(
     Task *const task,
@@ -52,6 +63,22 @@ void task_init(
     task->sig_wait = 0;
     task->sig_recvd = 0;
     task->id_nestcnt = -1;
+    task->partition = 0;
+    task->weight = TASK_WEIGHT_DEFAULT;
+    task->vruntime = 0;
+    task->affinity = CPUSET_ALL;
+    task->cpu = 0;
+    task->periodic = NULL;
+    list_init(&task->requests);
+    task->timeout.task = task;
+    task->timeout.signal = 0;
+    task->timeout.slack = 0;
+    task->timeout.missed = TIMER_CATCH_UP;
+    task->timeout.callback = NULL;
+    task->timeout.message = NULL;
+    task->timeout.op = TIMER_DELAY;
+    task->timeout.status = TIMER_INITIALIZED;
+    task->timed_out = false;
     taskcontext_init(&task->context, init_pc, user_data, stack, stack_size);
     task->state = TASK_INITIALIZED;
 }
@@ -61,46 +88,234 @@ void task_schedule(Task *const task)
     task_verify(task);
     disable();
     task->state = TASK_READY;
-    list_enqueue(&ready, (Node *) task);
+#if FAIR_SHARE
+    fair_wakeup(task);
+#endif
+    ready_enqueue(task);
     enable();
     reschedule();
 }
 
+/* Return task if it has the given name. */
+static Task *task_match(Task *const task, char *const name)
+{
+    if (NULL != task && 0 == strcmp(name, task->node.name)) {
+        return task;
+    }
+    return NULL;
+}
+
 Task *task_find(char *const name)
 {
     Task *task;
+#if 1 < CPUS
+    uint_fast8_t cpu;
+#endif
 
     if (NULL == name) {
         return running;
     }
     disable();
     /* Try system lists. */
-    task = (Task *) list_find(&ready, name);
+    task = (Task *) list_find(&waiting, name);
+#if 1 < CPUS
+    for (cpu = 0; NULL == task && cpu < CPUS; cpu++) {
+        task = (Task *) list_find(&cpus[cpu].queue, name);
+        if (NULL == task) {
+            task = task_match(cpus[cpu].current, name);
+        }
+    }
+#else
     if (NULL == task) {
-        task = (Task *) list_find(&waiting, name);
+        task = (Task *) list_find(&ready, name);
         if (NULL == task) {
             /* Try self. */
-            if (0 == strcmp(name, task->node.name)) {
-                task = running;
-            }
+            task = task_match(running, name);
         }
     }
+#endif
     enable();
     return task;
 }
 
 void task_set_prio(Task *const task, const Node_Prio prio)
 {
+    MinNode *node;
+    SemaphoreRequest *req;
+
     disable();
     task->node.prio = prio;
+    if (TASK_READY == task->state) {
+        list_unlink((Node *) task);
+#if FAIR_SHARE
+        /* Compete at the new priority as if just woken. */
+        fair_wakeup(task);
+#endif
+        ready_enqueue(task);
+    }
+#if FAIR_SHARE
+    else if (TASK_RUNNING == task->state) {
+        fair_wakeup(task);
+    }
+#endif
+    /* Reposition in wait queues. */
+    LIST_FOR_EACH(node, &task->requests) {
+        req = LIST_CONTAINER(node, SemaphoreRequest, task_node);
+        plist_remove(req->queue, &req->node);
+        req->node.prio = prio;
+        plist_add(req->queue, &req->node);
+    }
     if (task == running ||
-      (TASK_READY == task->state &&
-      running->node.prio < task->node.prio)) {
+      (TASK_READY == task->state && task_preempts(task))) {
         reschedule();
     }
+#if 1 < CPUS
+    else if (TASK_RUNNING == task->state) {
+        /* Running on another core. */
+        cpu_reschedule(task->cpu);
+    }
+#endif
+    enable();
+}
+
+void task_set_partition(Task *const task, const uint_fast8_t partition)
+{
+    assert(partition < PARTITIONS_WIDTH);
+    disable();
+    task->partition = partition;
+    if (TASK_RUNNING == task->state || TASK_READY == task->state) {
+        reschedule();
+    }
+    enable();
+}
+
+void task_set_weight(Task *const task, const uint16_t weight)
+{
+    assert(0 < weight);
+    disable();
+    task->weight = weight;
+    enable();
+}
+
+void task_set_affinity(Task *const task, const CpuSet affinity)
+{
+    assert(0 != (affinity & (CpuSet) ((UINT64_C(1) << CPUS) - 1)));
+    disable();
+    task->affinity = affinity;
+#if 1 < CPUS
+    if (0 == (affinity & ((CpuSet) 1 << task->cpu))) {
+        if (TASK_READY == task->state) {
+            list_unlink((Node *) task);
+            ready_enqueue(task);
+        } else if (TASK_RUNNING == task->state) {
+            /* It is moved when switched out. */
+            if (task->cpu == cpu_id()) {
+                reschedule();
+            } else {
+                cpu_reschedule(task->cpu);
+            }
+        }
+    }
+#endif
     enable();
 }
 
+#if 1 < CPUS
+/* Select the core to make task ready on. The core it was on
+last is kept unless the task can preempt a lower priority task
+on another allowed core. */
+KERNEL_CODE_PLACEMENT static uint_fast8_t cpu_select(Task *const task)
+{
+    uint_fast8_t cpu;
+    uint_fast8_t home;
+    uint_fast8_t best;
+
+    home = task->cpu;
+    if (0 == (task->affinity & ((CpuSet) 1 << home))) {
+        home = 0;
+        while (0 == (task->affinity & ((CpuSet) 1 << home))) {
+            home++;
+        }
+    }
+    best = home;
+    for (cpu = 0; cpu < CPUS; cpu++) {
+        if ((task->affinity & ((CpuSet) 1 << cpu)) &&
+          cpus[cpu].current->node.prio < cpus[best].current->node.prio) {
+            best = cpu;
+        }
+    }
+    if (cpus[best].current->node.prio < task->node.prio) {
+        return best;
+    }
+    return home;
+}
+
+/* Remove the task to run next on the executing core. A task at
+the head of another core's queue is pulled over if it has
+higher priority and may run here. */
+KERNEL_CODE_PLACEMENT static Task *cpu_pull(void)
+{
+    uint_fast8_t cpu;
+    List *queue;
+    Node *node;
+    Task *task;
+
+    queue = &ready;
+    for (cpu = 0; cpu < CPUS; cpu++) {
+        node = (Node *) cpus[cpu].queue.head.next;
+        if (NULL != node->next &&
+          (((Task *) node)->affinity & ((CpuSet) 1 << cpu_id())) &&
+          (list_is_empty(queue) ||
+          ((Node *) queue->head.next)->prio < node->prio)) {
+            queue = &cpus[cpu].queue;
+        }
+    }
+    task = (Task *) list_rem_head(queue);
+    task->cpu = cpu_id();
+    return task;
+}
+#endif
+
+KERNEL_CODE_PLACEMENT PRIVATE void ready_enqueue(Task *const task)
+{
+#if FAIR_SHARE
+    fair_enqueue(task);
+#elif 1 < CPUS
+    task->cpu = cpu_select(task);
+    list_enqueue(&cpus[task->cpu].queue, (Node *) task);
+    if (task->cpu != cpu_id() &&
+      cpus[task->cpu].current->node.prio < task->node.prio) {
+        cpu_reschedule(task->cpu);
+    }
+#else
+    list_enqueue(&ready, (Node *) task);
+#endif
+}
+
+/* Return true if a task which has become ready shall preempt
+the running task. */
+KERNEL_CODE_PLACEMENT static bool task_preempts(Task *const task)
+{
+#if PARTITION_WINDOWS
+    return partition_preempts(task);
+#elif 1 < CPUS
+    return task->cpu == cpu_id() && running->node.prio < task->node.prio;
+#else
+    return running->node.prio < task->node.prio;
+#endif
+}
+
+KERNEL_CODE_PLACEMENT PRIVATE Task *task_next(void)
+{
+#if PARTITION_WINDOWS
+    return partition_next();
+#elif 1 < CPUS
+    return cpu_pull();
+#else
+    return (Task *) list_rem_head(&ready);
+#endif
+}
+
 SignalNumber signal_allocate(SignalNumber signal)
 {
     assert(-1 <= signal && signal < SIGNALS_WIDTH);
@@ -155,28 +370,47 @@ void signal_free(const Signals signals)
     running->sig_alloc &= ~signals;
 }
 
-void signal_send(Task *const task, const Signals signals)
+/* Make a waiting task ready. Interrupts must be disabled. */
+KERNEL_CODE_PLACEMENT static void task_wakeup(Task *const task)
+{
+    /* Take out of waiting list. */
+    list_unlink((Node *) task);
+    /* Move woken task to ready list. */
+    task->state = TASK_READY;
+#if FAIR_SHARE
+    fair_wakeup(task);
+#endif
+    ready_enqueue(task);
+    if (task_preempts(task)) {
+        /* Woken task has higher priority: reschedule. */
+        reschedule();
+    } else {
+        /* task has lower priority: leave it.
+           task has same  priority: let running have its
+           time elapse.
+         */
+    }
+}
+
+KERNEL_CODE_PLACEMENT void signal_send(Task *const task, const Signals signals)
 {
     disable();
     task->sig_recvd |= signals;
     if (TASK_WAITING == task->state
         && (signals & task->sig_wait)) {
         /* We have set signals which the task was waiting
-        for. Take out of waiting list.  */
-        list_unlink((Node *) task);
-        /* Move signalled task to ready list. */
-        task->state = TASK_READY;
-        list_enqueue(&ready, (Node *) task);
-        if (running->node.prio < task->node.prio) {
-            /* Signalled task has higher priority:
-            reschedule. */
-            reschedule();
-        } else {
-            /* task has lower priority: leave it.
-               task has same  priority: let running have its
-               time elapse.
-             */
-        }
+        for. */
+        task_wakeup(task);
+    }
+    enable();
+}
+
+KERNEL_CODE_PLACEMENT PRIVATE void task_timeout(Task *const task)
+{
+    disable();
+    task->timed_out = true;
+    if (TASK_WAITING == task->state) {
+        task_wakeup(task);
     }
     enable();
 }
@@ -188,7 +422,9 @@ Signals signal_wait(const Signals signals)
 
     disable();
     running->sig_wait = signals;
-    while (!(signals & running->sig_recvd)) {
+    /* An expired timeout, see task_timeout_start(), ends the wait
+    with no signals. */
+    while (!(signals & running->sig_recvd) && !running->timed_out) {
         running->state = TASK_WAITING;
         list_add_tail(&waiting, (Node *) running);
         /* Block, we must be switched out! */
@@ -197,12 +433,16 @@ Signals signal_wait(const Signals signals)
 
         nestcnt = id_nestcnt;
         id_nestcnt = 0;
-        enable();
+        /* The switch is requested before enable() so that it is
+        taken when interrupts are enabled. Otherwise another
+        core could make the task ready and run it before it has
+        been switched out here. */
+        reschedule();
         /* Now it's time to break any disable() state made
         before call to task_wait(). The fake id_nestcnt will
         be saved in task->id_nestcnt by reschedule. We have
         the real value locally backed up in nestcnt. */
-        reschedule();
+        enable();
         disable();
         id_nestcnt = nestcnt;
     }
@@ -212,6 +452,78 @@ Signals signal_wait(const Signals signals)
     return rcvd;
 }
 
+Signals signal_wait_timeout(const Signals signals, const Ticks timeout)
+{
+    Signals rcvd;
+
+    disable();
+    rcvd = signal_try_wait(signals);
+    if (0 == rcvd) {
+        task_timeout_start(timeout);
+        rcvd = signal_wait(signals);
+        task_timeout_stop();
+    }
+    enable();
+    return rcvd;
+}
+
+Signals signal_try_wait(const Signals signals)
+{
+    Signals rcvd;
+
+    disable();
+    rcvd = signals & running->sig_recvd;
+    running->sig_recvd &= ~rcvd;
+    enable();
+    return rcvd;
+}
+
+PRIVATE void task_timeout_start(const Ticks timeout)
+{
+    Timer *const timer = &running->timeout;
+
+    assert(TIMER_ADDED != timer->status);
+    running->timed_out = false;
+    timer->delay = timeout;
+    timer_add(timer);
+    if (TIMER_ADDED != timer->status) {
+        /* Already elapsed. */
+        running->timed_out = true;
+    }
+}
+
+PRIVATE void task_timeout_stop(void)
+{
+    timer_abort(&running->timeout);
+    running->timed_out = false;
+}
+
+PRIVATE void request_enqueue(PrioList *const queue, SemaphoreRequest *const req)
+{
+    req->node.prio = req->waiter->node.prio;
+    req->queue = queue;
+    plist_add(queue, &req->node);
+    list_add_tail(&req->waiter->requests, (Node *) &req->task_node);
+}
+
+PRIVATE void request_remove(SemaphoreRequest *const req)
+{
+    plist_remove(req->queue, &req->node);
+    list_unlink((Node *) &req->task_node);
+    req->queue = NULL;
+}
+
+PRIVATE SemaphoreRequest *request_dequeue(PrioList *const queue)
+{
+    SemaphoreRequest *req;
+
+    req = (SemaphoreRequest *) plist_get_head(queue);
+    if (NULL != req) {
+        request_remove(req);
+    }
+    return req;
+}
+
 PRIVATE void task_verify(Task *const task)
 {
     disable();
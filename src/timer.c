@@ -33,24 +33,176 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <martos/martos.h>
 #include "private.h"
 #include "platform_protos.h"
+#include "default_config.h"
 
-/* List for timer requests. */
-static List timers;
+enum {WHEEL_SLOTS = 1 << TIMER_WHEEL_BITS};
+enum {
+    WHEEL_LEVELS =
+      (sizeof (Ticks) * 8 + TIMER_WHEEL_BITS - 1) / TIMER_WHEEL_BITS
+};
 
-void timer_delay(Ticks ticks)
+/* Timer requests are kept in a hierarchical timing wheel. Level n
+has WHEEL_SLOTS slots of WHEEL_SLOTS^n ticks each. A request is put
+on the lowest level which spans its remaining time, in the slot
+given by the corresponding bits of its tick. When the lower bits
+of the wheel time roll over to zero, the current slot of the level
+above is cascaded: its requests are put back on lower levels. The
+requests in a level 0 slot all expire at the tick of the slot. */
+KERNEL_DATA_PLACEMENT static List wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+
+/* Tick which the wheel is at. */
+KERNEL_DATA_PLACEMENT static Ticks wheel_now;
+
+/* True if all requests due at wheel_now have been handled. */
+KERNEL_DATA_PLACEMENT static bool wheel_done;
+
+/* Expiries at wheel_now so far, on their own tick and moved there
+by their slack. */
+static uint32_t tick_exact;
+static uint32_t tick_moved;
+
+/* Expiries which shared a tick with another because of slack. */
+static uint32_t wakeups_saved;
+
+#if TIMER_SERVICE
+/* Drop an expiry of a callback request which the timer service has
+not yet taken. Interrupts must be disabled. */
+static void timer_unpost(Timer *const timer)
 {
-    Timer timer;
-
-    timer_allocate(&timer);
-    timer.op = TIMER_DELAY;
-    timer.delay = ticks;
-    timer_add(&timer);
-    if (TIMER_ADDED == timer.status) {
-        signal_wait(timer.signal);
-    } else {
-        /* Already elapsed. */
+    if (NULL != timer->callback && 0 != timer->pending) {
+        list_unlink((Node *) &timer->expired);
+        timer->pending = 0;
+    }
+}
+#endif
+
+/* Put timer in the slot for its tick. Interrupts must be
+disabled. */
+KERNEL_CODE_PLACEMENT static void wheel_insert(Timer *const timer)
+{
+    Ticks span;
+    uint_fast8_t level;
+    uint_fast8_t slot;
+
+    level = 0;
+    span = (timer->expires - wheel_now) >> TIMER_WHEEL_BITS;
+    while (0 != span) {
+        level++;
+        span >>= TIMER_WHEEL_BITS;
+    }
+    slot = (timer->expires >> (level * TIMER_WHEEL_BITS)) & (WHEEL_SLOTS - 1);
+    list_add_tail(&wheel[level][slot], &timer->node);
+}
+
+/* Set the tick at which timer expires, within its slack after
+timer->tick. Interrupts must be disabled. */
+static void timer_coalesce(Timer *const timer)
+{
+    const Ticks limit = timer->tick + timer->slack;
+    Ticks tick;
+
+    if (0 == timer->slack) {
+        timer->expires = timer->tick;
+        return;
+    }
+    /* Join a near tick which already has an expiry. */
+    for (
+      tick = timer->tick;
+      timer_reached(tick, limit) && tick - wheel_now < WHEEL_SLOTS;
+      tick++
+    ) {
+        if (false == list_is_empty(&wheel[0][tick & (WHEEL_SLOTS - 1)])) {
+            timer->expires = tick;
+            return;
+        }
     }
-    timer_free(&timer);
+    /* Else take the tick in the window which is a multiple of the
+    largest power of two, so that requests with overlapping
+    windows tend to meet. */
+    tick = timer->tick - 1;
+    tick = (Ticks) 1 << (31 - __builtin_clz(tick ^ limit));
+    timer->expires = limit & ~(tick - 1);
+}
+
+/* Do the cascades and expiries due at wheel_now, at most *budget
+requests. Returns true if the tick was completed, otherwise the
+remaining work is continued on the next call. */
+KERNEL_CODE_PLACEMENT static bool wheel_step(uint_fast16_t *const budget)
+{
+    uint_fast8_t level;
+    uint_fast8_t shift;
+    List *slot;
+    Timer *tnode;
+
+    for (level = 1; level < WHEEL_LEVELS; level++) {
+        shift = level * TIMER_WHEEL_BITS;
+        if (0 != (wheel_now & (((Ticks) 1 << shift) - 1))) {
+            break;
+        }
+        /* A cascaded request lands on a lower level, or on level 0
+        at wheel_now which is expired below. */
+        slot = &wheel[level][(wheel_now >> shift) & (WHEEL_SLOTS - 1)];
+        while (false == list_is_empty(slot)) {
+            if (0 == *budget) {
+                return false;
+            }
+            (*budget)--;
+            wheel_insert((Timer *) list_rem_head(slot));
+        }
+    }
+
+    slot = &wheel[0][wheel_now & (WHEEL_SLOTS - 1)];
+    while (false == list_is_empty(slot)) {
+        if (0 == *budget) {
+            return false;
+        }
+        (*budget)--;
+        tnode = (Timer *) list_rem_head(slot);
+        if (tnode->expires == tnode->tick) {
+            tick_exact++;
+        } else {
+            tick_moved++;
+        }
+        if (0 != tnode->pending) {
+            tnode->overruns++;
+#if TIMER_SERVICE
+        } else if (NULL != tnode->callback) {
+            /* Not yet queued to the service. */
+            timer_service_post(tnode);
+#endif
+        }
+        tnode->pending++;
+        if (TIMER_PERIODIC == tnode->op) {
+            /* Reload from the expired tick, not from when it was
+            handled, so that there is no drift. */
+            tnode->tick += tnode->period;
+            timer_coalesce(tnode);
+            wheel_insert(tnode);
+        } else {
+            tnode->status = TIMER_DONE;
+        }
+        if (NULL != tnode->callback) {
+            /* Handled by the timer service. */
+        } else if (NULL != tnode->message) {
+            msgport_reply(tnode->message);
+        } else if (0 == tnode->signal) {
+            /* The timeout of a timed wait. */
+            task_timeout(tnode->task);
+        } else {
+            signal_send(tnode->task, tnode->signal);
+        }
+    }
+    if (0 != tick_moved) {
+        /* One of them would have had its own tick anyway. */
+        wakeups_saved += 0 != tick_exact ? tick_moved : tick_moved - 1;
+    }
+    return true;
+}
+
+void timer_delay(Ticks ticks)
+{
+    /* Wait for no signals on the timeout of the task. */
+    signal_wait_timeout(0, ticks);
 }
 
 void timer_allocate(Timer *timer)
@@ -63,6 +215,28 @@ void timer_allocate(Timer *timer)
     assert(-1 != signum);
     timer->signal = 1 << signum;
 
+    timer->slack = 0;
+    timer->missed = TIMER_CATCH_UP;
+    timer->callback = NULL;
+    timer->message = NULL;
+    timer->op = TIMER_NONE;
+    timer->status = TIMER_INITIALIZED;
+}
+
+void timer_init_message(TimerMessage *const request, MsgPort *const port)
+{
+    Timer *const timer = &request->timer;
+
+    assert(NULL != port);
+    request->message.node.next = NULL;
+    request->message.reply_port = port;
+    timer->task = NULL;
+    timer->signal = 0;
+    timer->slack = 0;
+    timer->missed = TIMER_CATCH_UP;
+    timer->callback = NULL;
+    timer->message = &request->message;
+    timer->pending = 0;
     timer->op = TIMER_NONE;
     timer->status = TIMER_INITIALIZED;
 }
@@ -80,7 +254,8 @@ void timer_add(Timer *timer)
 {
     assert(
       TIMER_DELAY == timer->op ||
-      TIMER_ALARM == timer->op
+      TIMER_ALARM == timer->op ||
+      TIMER_PERIODIC == timer->op
     );
     assert(
       TIMER_INITIALIZED == timer->status ||
@@ -88,46 +263,68 @@ void timer_add(Timer *timer)
       TIMER_ABORTED == timer->status
     );
 
+    disable();
     if (TIMER_DELAY == timer->op) {
+        assert(timer->delay <= TIMER_DELAY_MAX);
         timer->tick = timer_get_clock() + timer->delay;
     } else {
         /* Tick was already set. */
     }
+    assert(timer->slack <= TIMER_DELAY_MAX);
+    if (TIMER_PERIODIC == timer->op) {
+        assert(0 < timer->period && timer->period <= TIMER_DELAY_MAX);
+        assert(timer->slack < timer->period);
+    }
+#if !TIMER_SERVICE
+    assert(NULL == timer->callback);
+#endif
+    assert(NULL == timer->message || TIMER_PERIODIC != timer->op);
+    if (NULL != timer->message && NULL != timer->message->node.next) {
+        /* The last reply has not been taken with msgport_get(),
+        and the message can not be queued twice. */
+        enable();
+        return;
+    }
+#if TIMER_SERVICE
+    timer_unpost(timer);
+#endif
+    timer->pending = 0;
+    timer->overruns = 0;
 
     /* Check if timer->tick has already elapsed. */
-    if (timer->tick <= timer_get_clock()) {
+    if (timer_reached(timer->tick, timer_get_clock())) {
         timer->status = TIMER_ABORTED;
-        return;
+        if (NULL != timer->message) {
+            msgport_reply(timer->message);
+        }
+    } else {
+        timer->status = TIMER_ADDED;
+        timer_coalesce(timer);
+        wheel_insert(timer);
     }
+    enable();
+}
 
-    /* Insert timer in the timers queue according to
-    timer->tick. The timers queue must be sorted. */
-
-    Timer *tnode;
-    bool added = false;
+uint32_t timer_wait(Timer *const timer)
+{
+    uint32_t expirations;
 
-    disable();
-    timer->status = TIMER_ADDED;
-    tnode = (Timer *) timers.head.next;
-    while (NULL != tnode->node.next) {
-        /* For each Timer in timers. */
-        /* FIXME: Handle wrap-around! */
-        if (timer->tick < tnode->tick) {
-            /* Tick in the new Timer is less than nt. Add the
-            new Timer before the found timer. */
-            list_insert(&timers, &timer->node, tnode->node.prev);
-            added = true;
-            break;
-        }
-        tnode = (Timer *) tnode->node.next;
-    }
+    assert(running == timer->task);
+    assert(NULL == timer->callback);
+    /* The signal may be left from an expiration which was taken
+    by the previous call. */
+    do {
+        signal_wait(timer->signal);
+        disable();
+        expirations = timer->pending;
+        timer->pending = 0;
+        enable();
+    } while (0 == expirations);
 
-    if (false == added) {
-        /* The timers queue was empty or timer shall be at
-        end. */
-        list_add_tail(&timers, &timer->node);
+    if (TIMER_PERIODIC == timer->op && TIMER_SKIP == timer->missed) {
+        expirations = 1;
     }
-    enable();
+    return expirations;
 }
 
 void timer_abort(Timer *const timer)
@@ -135,36 +332,57 @@ void timer_abort(Timer *const timer)
     disable();
     if (TIMER_ADDED == timer->status) {
         list_unlink((Node *) timer);
+        timer->status = TIMER_ABORTED;
+        if (NULL != timer->message) {
+            msgport_reply(timer->message);
+        }
     }
+#if TIMER_SERVICE
+    timer_unpost(timer);
+#endif
     enable();
 }
 
-PRIVATE void timer_poll(void)
+uint32_t timer_get_wakeups_saved(void)
 {
-    Ticks now = timer_get_clock();
+    return wakeups_saved;
+}
 
-    Timer *tnode;
+KERNEL_CODE_PLACEMENT PRIVATE void timer_poll(void)
+{
+    const Ticks now = timer_get_clock();
+    /* Each tick advanced costs one unit, so that catching up after
+    a long gap is bounded as well. */
+    uint_fast16_t budget = TIMER_POLL_BUDGET;
 
     disable();
-    tnode = (Timer *) timers.head.next;
-    while (NULL != tnode->node.next) {
-        /* For each Timer in timers. */
-        /* FIXME: Handle wrap-around! */
-        if (now < tnode->tick) {
-            break;
+    do {
+        if (wheel_done) {
+            if (timer_reached(now, wheel_now) || 0 == budget) {
+                break;
+            }
+            budget--;
+            wheel_now++;
+            tick_exact = 0;
+            tick_moved = 0;
         }
-        /* Tick in tnode is greater than now. Remove and signal. */
-        list_unlink(&tnode->node);
-        tnode->status = TIMER_DONE;
-        signal_send(tnode->task, tnode->signal);
-        /* Next. */
-        tnode = (Timer *) tnode->node.next;
-    }
+        wheel_done = wheel_step(&budget);
+    } while (wheel_done);
     enable();
 }
 
 PRIVATE void timer_init(void) {
-    list_init(&timers);
+    uint_fast8_t level;
+    uint_fast8_t slot;
+
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < WHEEL_SLOTS; slot++) {
+            list_init(&wheel[level][slot]);
+        }
+    }
+    disable();
     timer_init_platform();
+    wheel_now = timer_get_clock();
+    wheel_done = true;
+    enable();
 }
-
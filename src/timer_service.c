@@ -0,0 +1,170 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <assert.h>
+#include <martos/martos.h>
+#include "private.h"
+#include "platform_protos.h"
+#include "default_config.h"
+
+/* Timer service. Callback requests which expire are queued here
+by timer_poll() and the service task is signalled once for all of
+them. The task calls the callbacks in expiry order. */
+
+enum {SIG_SERVICE = 1};
+enum {SIGF_SERVICE = 1 << SIG_SERVICE};
+
+static Task service_task;
+static uint8_t service_task_stack[TIMER_SERVICE_STACK_SIZE]
+  __attribute__ ((aligned (8)));
+
+/* Expired callback requests not yet taken by the service task. */
+KERNEL_DATA_PLACEMENT static List service_queue;
+static TimerServiceStats service_stats;
+
+void timer_init_callback(
+    Timer *const timer,
+    void (*const callback)(Timer *const timer),
+    void *const user_data
+)
+{
+    assert(NULL != callback);
+
+    timer->task = NULL;
+    timer->signal = 0;
+    timer->callback = callback;
+    timer->user_data = user_data;
+    timer->message = NULL;
+    timer->pending = 0;
+    timer->slack = 0;
+    timer->missed = TIMER_CATCH_UP;
+    timer->op = TIMER_NONE;
+    timer->status = TIMER_INITIALIZED;
+}
+
+void timer_service_get_stats(TimerServiceStats *const stats)
+{
+    disable();
+    *stats = service_stats;
+    enable();
+}
+
+KERNEL_CODE_PLACEMENT PRIVATE void timer_service_post(Timer *const timer)
+{
+    list_add_tail(&service_queue, (Node *) &timer->expired);
+    signal_send(&service_task, SIGF_SERVICE);
+}
+
+/* Call the callback of timer once for each expiration taken. */
+static void service_call(Timer *const timer, uint32_t expirations)
+{
+    uint64_t start;
+    uint64_t duration;
+
+    if (TIMER_PERIODIC == timer->op && TIMER_SKIP == timer->missed) {
+        expirations = 1;
+    }
+    while (0 != expirations) {
+        start = timer_get_ns();
+        timer->callback(timer);
+        duration = timer_get_ns() - start;
+        disable();
+        service_stats.callbacks++;
+        if (service_stats.callback_max < duration) {
+            service_stats.callback_max = duration;
+        }
+        enable();
+        expirations--;
+    }
+}
+
+static void service_task_f(void *user_data)
+{
+    Timer *timer;
+    uint32_t expirations;
+    uint32_t batch;
+    uint64_t start;
+
+    while (1) {
+        signal_wait(SIGF_SERVICE);
+        start = timer_get_ns();
+        batch = 0;
+        while (1) {
+            disable();
+            if (list_is_empty(&service_queue)) {
+                enable();
+                break;
+            }
+            timer = LIST_CONTAINER(
+              (MinNode *) list_rem_head(&service_queue), Timer, expired
+            );
+            expirations = timer->pending;
+            timer->pending = 0;
+            enable();
+
+            service_call(timer, expirations);
+            batch++;
+
+            if (
+              0 != TIMER_SERVICE_LIMIT_US &&
+              (uint64_t) TIMER_SERVICE_LIMIT_US * 1000 <=
+                timer_get_ns() - start
+            ) {
+                /* Let lower priority tasks run before the rest. */
+                disable();
+                service_stats.deferrals++;
+                enable();
+                timer_delay(1);
+                start = timer_get_ns();
+            }
+        }
+        disable();
+        service_stats.batches++;
+        if (service_stats.batch_max < batch) {
+            service_stats.batch_max = batch;
+        }
+        enable();
+    }
+}
+
+PRIVATE void timer_service_init(void)
+{
+    list_init(&service_queue);
+    task_init(
+        &service_task,
+        "timers",
+        TIMER_SERVICE_PRIO,
+        (void (*const)(void *)) service_task_f,
+        NULL,
+        &service_task_stack,
+        TIMER_SERVICE_STACK_SIZE
+    );
+    /* Requests may be posted before the task has run. */
+    service_task.sig_alloc |= SIGF_SERVICE;
+    task_schedule(&service_task);
+}
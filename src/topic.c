@@ -0,0 +1,162 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <assert.h>
+#include <martos/martos.h>
+#include "private.h"
+#include "default_config.h"
+
+/* Publish/subscribe on message ports. A sample is not copied: each
+subscription with the sample pending holds a reference to it, and
+so does a subscriber between topic_receive() and topic_release().
+The message of a subscription is only a notification, sent when
+samples become pending, so it is never queued twice. All state is
+changed with interrupts disabled. */
+
+void topic_init(Topic *const topic, void (*const release)(Sample *const sample))
+{
+    list_init(&topic->subscribers);
+    topic->release = release;
+    topic->published = 0;
+}
+
+/* Drop a reference. Interrupts must be disabled. */
+KERNEL_CODE_PLACEMENT static void sample_put(Sample *const sample)
+{
+    assert(0 < sample->refs);
+    sample->refs--;
+    if (0 == sample->refs && NULL != sample->topic->release) {
+        sample->topic->release(sample);
+    }
+}
+
+void topic_subscribe(
+    Topic *const topic,
+    Subscription *const sub,
+    MsgPort *const port,
+    Sample **const backlog,
+    const uint16_t depth
+)
+{
+    assert(NULL != port);
+    sub->message.reply_port = NULL;
+    sub->topic = topic;
+    sub->port = port;
+    if (NULL == backlog) {
+        sub->backlog = &sub->latest;
+        sub->depth = 1;
+    } else {
+        assert(0 < depth);
+        sub->backlog = backlog;
+        sub->depth = depth;
+    }
+    sub->first = 0;
+    sub->count = 0;
+    sub->notified = false;
+    sub->dropped = 0;
+    disable();
+    list_add_tail(&topic->subscribers, (Node *) &sub->node);
+    enable();
+}
+
+void topic_unsubscribe(Subscription *const sub)
+{
+    disable();
+    list_unlink((Node *) &sub->node);
+    if (msgport_queued(sub->port, &sub->message)) {
+        /* Not received, so nobody else refers to it. */
+        list_unlink((Node *) &sub->message);
+    }
+    while (0 != sub->count) {
+        sample_put(sub->backlog[sub->first]);
+        sub->first = (sub->first + 1) % sub->depth;
+        sub->count--;
+    }
+    enable();
+}
+
+KERNEL_CODE_PLACEMENT static void subscription_push(
+    Subscription *const sub,
+    Sample *const sample
+)
+{
+    if (sub->depth == sub->count) {
+        /* Conflate: the oldest pending sample gives way. */
+        sample_put(sub->backlog[sub->first]);
+        sub->first = (sub->first + 1) % sub->depth;
+        sub->count--;
+        sub->dropped++;
+    }
+    sub->backlog[(sub->first + sub->count) % sub->depth] = sample;
+    sub->count++;
+    sample->refs++;
+    if (false == sub->notified) {
+        sub->notified = true;
+        msgport_send(sub->port, &sub->message);
+    }
+}
+
+KERNEL_CODE_PLACEMENT void topic_publish(Topic *const topic, Sample *const sample)
+{
+    MinNode *node;
+
+    disable();
+    sample->topic = topic;
+    /* Held by the publisher until all subscribers have it. */
+    sample->refs = 1;
+    topic->published++;
+    LIST_FOR_EACH(node, &topic->subscribers) {
+        subscription_push(LIST_CONTAINER(node, Subscription, node), sample);
+    }
+    sample_put(sample);
+    enable();
+}
+
+Sample *topic_receive(Subscription *const sub)
+{
+    Sample *sample;
+
+    disable();
+    if (0 == sub->count) {
+        sub->notified = false;
+        sample = NULL;
+    } else {
+        sample = sub->backlog[sub->first];
+        sub->first = (sub->first + 1) % sub->depth;
+        sub->count--;
+    }
+    enable();
+    return sample;
+}
+
+void topic_release(Sample *const sample)
+{
+    disable();
+    sample_put(sample);
+    enable();
+}
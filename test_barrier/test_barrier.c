@@ -0,0 +1,122 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include <martos/martos.h>
+#include <test_common.h>
+
+/* Worker tasks and the test task go through a barrier PHASES
+times. No task may start a phase before all have finished the
+previous one, and one task of each phase is the last. A task
+alone at a barrier times out and is not counted. */
+
+enum {WORKERS = 3, PARTIES = WORKERS + 1};
+enum {PHASES = 10000};
+enum {STACK_SIZE = 1024};
+
+static Task workers[WORKERS];
+static uint8_t stacks[WORKERS][STACK_SIZE];
+static char names[WORKERS][8];
+
+static Barrier barrier;
+static uint16_t finished[PHASES];
+static uint16_t lasts[PHASES];
+
+static double seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void phase(const int i)
+{
+    Barrier_Status status;
+
+    disable();
+    finished[i]++;
+    enable();
+    status = barrier_wait(&barrier);
+    assert(BARRIER_TIMEOUT != status);
+    assert(PARTIES == finished[i]);
+    if (BARRIER_LAST == status) {
+        disable();
+        lasts[i]++;
+        enable();
+    }
+}
+
+static void worker_f(void *user_data)
+{
+    int i;
+
+    for (i = 0; i < PHASES; i++) {
+        phase(i);
+    }
+    while (1) {
+        signal_wait(SIGF_SINGLE);
+    }
+}
+
+void test_task_f(void *user_data)
+{
+    Barrier alone;
+    double start;
+    int i;
+
+    barrier_init(&barrier, PARTIES);
+    for (i = 0; i < WORKERS; i++) {
+        snprintf(names[i], sizeof names[i], "work%d", i);
+        task_init(&workers[i], names[i], 1, worker_f, NULL, stacks[i],
+          STACK_SIZE);
+        task_schedule(&workers[i]);
+    }
+
+    start = seconds();
+    for (i = 0; i < PHASES; i++) {
+        phase(i);
+    }
+    printf("%.0f phases/s with %d tasks\n",
+      PHASES / (seconds() - start), PARTIES);
+    /* The last wakeups of the workers are not waited for. */
+    for (i = 0; i < PHASES - 1; i++) {
+        assert(1 == lasts[i]);
+    }
+    assert(0 == barrier.arrived);
+
+    barrier_init(&alone, 2);
+    assert(BARRIER_TIMEOUT == barrier_wait_timeout(&alone, 10));
+    assert(0 == alone.arrived);
+    assert(plist_is_empty(&alone.waiters));
+    assert(0 == alone.generation);
+
+    test_pass();
+}
@@ -0,0 +1,215 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+#include <martos/martos.h>
+#include <test_common.h>
+#include <stm32f4xx.h>
+
+/* Cycle counts of kernel operations, measured with the DWT
+cycle counter. Each operation is run BENCH_ROUNDS times and the
+smallest and largest count is kept, with the cost of calling an
+empty operation subtracted. Inspect the results with "print
+bench" when test_pass is reached. Build with CCM_KERNEL=1
+and/or RAM_KERNEL=1 to compare memory placements.
+
+The time taken by interrupts in one second is measured by
+spinning on the cycle counter, see "print isr_load". Build with
+TICK_RATE_HZ=... to compare tick rates. */
+
+enum {BENCH_ROUNDS = 100};
+/* A gap between two reads of the cycle counter longer than this
+is taken to be an interrupt. */
+enum {ISR_GAP_CYCLES = 40};
+enum {SIG_PING = 1, SIG_PONG = 2};
+enum {SIGF_PING = 1 << SIG_PING, SIGF_PONG = 1 << SIG_PONG};
+
+typedef struct {
+    const char *name;
+    void (*op)(void);
+    uint32_t min;
+    uint32_t max;
+} Bench;
+
+static List list;
+static List queue;
+static Node nodes[8];
+static MsgPort port;
+static Message message;
+static Semaphore sem;
+static Task *pinger;
+
+typedef struct {
+    uint32_t entries;
+    uint32_t cycles;
+    uint32_t cycles_max;
+} IsrLoad;
+
+IsrLoad isr_load;
+
+/* Answers each ping from the benchmark task. */
+static void pong_task_f(void *user_data)
+{
+    while (1) {
+        signal_wait(SIGF_PING);
+        signal_send(pinger, SIGF_PONG);
+    }
+}
+
+TASK_DECLARE(pong_task, 1, pong_task_f, NULL, 512, SIGF_PING);
+
+static void op_empty(void)
+{
+}
+
+static void op_list_add_rem(void)
+{
+    list_add_tail(&list, &nodes[0]);
+    list_rem_head(&list);
+}
+
+static void op_list_enqueue(void)
+{
+    /* Enqueue after the other nodes of the list. */
+    list_enqueue(&queue, &nodes[0]);
+    list_unlink(&nodes[0]);
+}
+
+static void op_signal_send(void)
+{
+    /* Not waited for, so no switch. */
+    signal_send(task_find(NULL), SIGF_SINGLE);
+}
+
+static void op_switch_round_trip(void)
+{
+    /* Switch to pong_task and back again. */
+    signal_send(&pong_task, SIGF_PING);
+    signal_wait(SIGF_PONG);
+}
+
+static void op_msgport_send_get(void)
+{
+    msgport_send(&port, &message);
+    msgport_get(&port);
+}
+
+static void op_sem_wait_signal(void)
+{
+    sem_wait(&sem);
+    sem_signal(&sem);
+}
+
+Bench bench[] = {
+    {"empty", op_empty, 0, 0},
+    {"list_add_tail+list_rem_head", op_list_add_rem, 0, 0},
+    {"list_enqueue+list_unlink, 7 nodes", op_list_enqueue, 0, 0},
+    {"signal_send, no wakeup", op_signal_send, 0, 0},
+    {"signal_send+signal_wait, two switches", op_switch_round_trip, 0, 0},
+    {"msgport_send+msgport_get", op_msgport_send_get, 0, 0},
+    {"sem_wait+sem_signal, uncontended", op_sem_wait_signal, 0, 0},
+};
+
+static void bench_run(Bench *const b, const uint32_t overhead)
+{
+    uint32_t i;
+    uint32_t start;
+    uint32_t cycles;
+
+    b->min = UINT32_MAX;
+    b->max = 0;
+    for (i = 0; i < BENCH_ROUNDS; i++) {
+        start = DWT->CYCCNT;
+        b->op();
+        cycles = DWT->CYCCNT - start - overhead;
+        if (cycles < b->min) {
+            b->min = cycles;
+        }
+        if (b->max < cycles) {
+            b->max = cycles;
+        }
+    }
+}
+
+/* Spin for one second and sum the gaps made by interrupts. */
+static void isr_load_run(IsrLoad *const load)
+{
+    uint32_t start;
+    uint32_t last;
+    uint32_t now;
+    uint32_t gap;
+
+    load->entries = 0;
+    load->cycles = 0;
+    load->cycles_max = 0;
+    start = DWT->CYCCNT;
+    last = start;
+    do {
+        now = DWT->CYCCNT;
+        gap = now - last;
+        if (ISR_GAP_CYCLES < gap) {
+            load->entries++;
+            load->cycles += gap;
+            if (load->cycles_max < gap) {
+                load->cycles_max = gap;
+            }
+        }
+        last = now;
+    } while (now - start < SystemCoreClock);
+}
+
+void test_task_f(void *user_data)
+{
+    size_t i;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    list_init(&list);
+    list_init(&queue);
+    for (i = 1; i < sizeof nodes / sizeof nodes[0]; i++) {
+        nodes[i].prio = 1;
+        list_add_tail(&queue, &nodes[i]);
+    }
+    nodes[0].prio = 0;
+    msgport_init(&port);
+    /* Messages are not waited for. */
+    port.action = MSGPORT_IGNORE;
+    sem_init(&sem, 1);
+    pinger = task_find(NULL);
+    assert(SIG_PONG == signal_allocate(SIG_PONG));
+
+    bench_run(&bench[0], 0);
+    for (i = 1; i < sizeof bench / sizeof bench[0]; i++) {
+        bench_run(&bench[i], bench[0].min);
+    }
+    isr_load_run(&isr_load);
+
+    test_pass();
+}
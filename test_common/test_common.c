@@ -27,6 +27,7 @@ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <martos/martos.h>
 #include "test_common.h"
 
@@ -35,6 +36,10 @@ uint8_t test_task_stack[TEST_STACK_SIZE];
 
 void test_pass(void)
 {
+#ifdef PLATFORM_HOSTED
+    /* There is no debugger to stop here. */
+    exit(EXIT_SUCCESS);
+#endif
     while(1) {
         ;
     }
@@ -0,0 +1,147 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <martos/martos.h>
+#include <test_common.h>
+
+/* Consumer tasks of different priority wait on a condition
+variable for tokens. They must be woken in priority order by
+cond_signal(), all at once by cond_broadcast(), and a timed wait
+must time out with the mutex taken again. */
+
+enum {WAITERS = 3};
+enum {STACK_SIZE = 1024};
+
+static Task waiters[WAITERS];
+static uint8_t stacks[WAITERS][STACK_SIZE];
+static char names[WAITERS][8];
+
+static Semaphore mutex;
+static CondVar cond;
+static int tokens;
+static Node_Prio order[WAITERS];
+static int taken;
+static Semaphore done;
+/* Lets the waiters wait for a token again. */
+static Semaphore again;
+
+static void waiter_f(void *user_data)
+{
+    Task *const self = task_find(NULL);
+
+    while (1) {
+        sem_wait(&mutex);
+        while (0 == tokens) {
+            cond_wait(&cond, &mutex);
+        }
+        tokens--;
+        order[taken % WAITERS] = self->node.prio;
+        taken++;
+        sem_signal(&mutex);
+        sem_signal(&done);
+        sem_wait(&again);
+    }
+}
+
+static void give(const int count, const bool broadcast)
+{
+    int i;
+
+    sem_wait(&mutex);
+    tokens += count;
+    if (broadcast) {
+        cond_broadcast(&cond);
+    } else {
+        cond_signal(&cond);
+    }
+    sem_signal(&mutex);
+    for (i = 0; i < count; i++) {
+        sem_wait(&done);
+    }
+}
+
+/* The waiters have higher priority, so they are back on cond
+when this returns. */
+static void rearm(void)
+{
+    int i;
+
+    for (i = 0; i < WAITERS; i++) {
+        sem_signal(&again);
+    }
+}
+
+void test_task_f(void *user_data)
+{
+    Ticks start;
+    int i;
+
+    sem_init(&mutex, 1);
+    sem_init(&done, 0);
+    sem_init(&again, 0);
+    cond_init(&cond);
+
+    /* Queued in order of creation, lowest priority first. */
+    for (i = 0; i < WAITERS; i++) {
+        snprintf(names[i], sizeof names[i], "wait%d", i);
+        task_init(&waiters[i], names[i], 1 + i, waiter_f, NULL,
+          stacks[i], STACK_SIZE);
+        task_schedule(&waiters[i]);
+    }
+    timer_delay(5);
+
+    for (i = 0; i < WAITERS; i++) {
+        give(1, false);
+    }
+    assert(WAITERS == taken);
+    for (i = 0; i < WAITERS; i++) {
+        assert(WAITERS - i == order[i]);
+    }
+
+    rearm();
+    give(WAITERS, true);
+    assert(2 * WAITERS == taken);
+    assert(0 == tokens);
+
+    /* Nobody signals. */
+    sem_wait(&mutex);
+    start = timer_get_clock();
+    assert(false == cond_wait_timeout(&cond, &mutex, 10));
+    assert(10 <= (Ticks) (timer_get_clock() - start));
+    assert(0 == mutex.count);
+    sem_signal(&mutex);
+
+    rearm();
+    give(1, false);
+    assert(WAITERS == order[(taken - 1) % WAITERS]);
+
+    test_pass();
+}
@@ -0,0 +1,95 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <martos/martos.h>
+
+/* The same operations as in cpp_api.cpp, using the C interface. */
+
+typedef struct {
+    Message message;
+    int data;
+} IntMessage;
+
+struct {
+    Task task;
+    uint8_t stack[1024];
+} worker;
+MsgPort port;
+MsgPort reply_port;
+IntMessage message;
+Semaphore sem;
+int counter;
+
+void worker_f(void *user_data);
+
+void start(void)
+{
+    task_init(
+        &worker.task,
+        "worker",
+        3,
+        worker_f,
+        NULL,
+        worker.stack,
+        sizeof worker.stack
+    );
+    task_schedule(&worker.task);
+}
+
+void send(int data)
+{
+    message.data = data;
+    message.message.reply_port = &reply_port;
+    msgport_send(&port, (Message *) &message);
+}
+
+int receive(void)
+{
+    IntMessage *m;
+    int data;
+
+    msgport_wait(&port);
+    m = (IntMessage *) msgport_get(&port);
+    data = m->data;
+    msgport_reply((Message *) m);
+    return data;
+}
+
+void locked(void)
+{
+    sem_wait(&sem);
+    counter++;
+    sem_signal(&sem);
+}
+
+void critical(void)
+{
+    disable();
+    counter++;
+    enable();
+}
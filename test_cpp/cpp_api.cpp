@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <martos/martos.hpp>
+
+/* The same operations as in c_api.c, using the C++ interface. */
+
+extern "C" {
+
+martos::Task<1024, 3> worker;
+martos::MsgPort<int> port;
+martos::MsgPort<int> reply_port;
+martos::Message<int> message;
+Semaphore sem;
+int counter;
+
+void worker_f(void *user_data);
+
+void start(void)
+{
+    worker.init("worker", worker_f);
+    worker.schedule();
+}
+
+void send(int data)
+{
+    message.data = data;
+    message.set_reply_port(reply_port);
+    port.send(message);
+}
+
+int receive(void)
+{
+    martos::Message<int> *m;
+    int data;
+
+    port.wait();
+    m = port.get();
+    data = m->data;
+    m->reply();
+    return data;
+}
+
+void locked(void)
+{
+    martos::SemaphoreGuard guard(sem);
+    counter++;
+}
+
+void critical(void)
+{
+    martos::CriticalSection cs;
+    counter++;
+}
+
+}
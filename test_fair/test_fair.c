@@ -0,0 +1,147 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+#include <martos/martos.h>
+#include <test_common.h>
+
+/* Tasks of one priority spin and count while the test task, with
+higher priority, sleeps. Shares of the processor shall follow the
+weights, the least weighted task shall not starve, and a task which
+has slept long shall not take the processor from the others until
+it has caught up with them. */
+
+enum {SPINNERS = 5};
+enum {LATE = 4};
+enum {SPAN = 1000};
+enum {STACK_SIZE = 1024};
+
+static const uint16_t weights[SPINNERS] = {256, 256, 512, 32, 256};
+static char *const names[SPINNERS] = {"a", "b", "c", "d", "late"};
+
+static Task tasks[SPINNERS];
+static uint8_t stacks[SPINNERS][STACK_SIZE];
+static volatile uint32_t counts[SPINNERS];
+static Semaphore start_late;
+
+static void spin_f(void *user_data)
+{
+    volatile uint32_t *const count = user_data;
+    int i;
+
+    if (&counts[LATE] == count) {
+        sem_wait(&start_late);
+    }
+    while (1) {
+        for (i = 0; i < 1000; i++) {
+            (*count)++;
+        }
+        /* The hosted port switches tasks in enable(). The lock is
+        taken seldom so that the tick is not held up. */
+        disable();
+        enable();
+    }
+}
+
+/* Ratio of a to b in percent. */
+static uint32_t percent(const uint32_t a, const uint32_t b)
+{
+    assert(0 < b);
+    return (uint32_t) ((uint64_t) a * 100 / b);
+}
+
+static void test_shares(void)
+{
+    uint64_t least;
+    uint64_t most;
+    int i;
+
+    timer_delay(SPAN);
+    /* Weight 512 gets twice the share of weight 256. */
+    assert(percent(counts[0], counts[1]) > 66);
+    assert(percent(counts[0], counts[1]) < 150);
+    assert(percent(counts[2], counts[0]) > 140);
+    assert(percent(counts[2], counts[0]) < 280);
+    /* Weight 32 gets an eighth of the share of weight 256. */
+    assert(percent(counts[3], counts[0]) > 6);
+    assert(percent(counts[3], counts[0]) < 25);
+    assert(0 == counts[LATE]);
+
+    /* The least vruntime runs next, so the vruntimes stay close.
+    With round-robin the task of weight 512 would trail by an
+    eighth of SPAN. The task of weight 32 leads by up to eight
+    slices after each of its turns and is left out. */
+    least = UINT64_MAX;
+    most = 0;
+    for (i = 0; i < 3; i++) {
+        if (tasks[i].vruntime < least) {
+            least = tasks[i].vruntime;
+        }
+        if (most < tasks[i].vruntime) {
+            most = tasks[i].vruntime;
+        }
+    }
+    assert(most - least < (uint64_t) SPAN * PLATFORM_TICK_NS / 10);
+}
+
+static void test_late(void)
+{
+    uint32_t before[SPINNERS];
+    int i;
+
+    sem_signal(&start_late);
+    for (i = 0; i < SPINNERS; i++) {
+        before[i] = counts[i];
+    }
+    timer_delay(SPAN / 5);
+    /* The others kept running while the late task ran. The task
+    of weight 32 may not be due for a turn yet. */
+    for (i = 0; i < SPINNERS; i++) {
+        assert(3 == i || before[i] < counts[i]);
+    }
+    assert(percent(counts[LATE], counts[0] - before[0]) < 200);
+}
+
+void test_task_f(void *user_data)
+{
+    Task *const self = task_find(NULL);
+    int i;
+
+    sem_init(&start_late, 0);
+    task_set_prio(self, 2);
+    for (i = 0; i < SPINNERS; i++) {
+        task_init(&tasks[i], names[i], 1, spin_f, (void *) &counts[i],
+          stacks[i], STACK_SIZE);
+        task_set_weight(&tasks[i], weights[i]);
+        task_schedule(&tasks[i]);
+    }
+    test_shares();
+    test_late();
+
+    test_pass();
+}
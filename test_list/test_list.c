@@ -81,6 +81,78 @@ void test_task_f(void *user_data)
     assert(NULL == list_find(&l, "one"));
     assert(NULL == list_find(&l, "two"));
 
+    List l2;
+    Node n3;
+    Node *node;
+    Node *next;
+    int count;
+
+    list_init(&l2);
+    n3.prio = 5;
+    n3.name = "three";
+
+    assert(NULL == list_get_tail(&l));
+    list_insert(&l, &n2, NULL);
+    assert(&n2 == list_get_head(&l));
+    list_add_head(&l, &n1);
+    assert(&n1 == list_get_head(&l));
+    assert(&n2 == list_get_tail(&l));
+    list_insert(&l, &n3, &n1);
+    assert(&n3 == n1.next);
+    assert(&n2 == list_rem_tail(&l));
+    list_insert_before(&n1, &n2);
+    assert(&n2 == list_get_head(&l));
+
+    list_splice(&l2, &l);
+    assert(true == list_is_empty(&l));
+    count = 0;
+    LIST_FOR_EACH(node, &l2) {
+        count++;
+    }
+    assert(3 == count);
+    assert(&n2 == list_get_head(&l2));
+    assert(&n3 == list_get_tail(&l2));
+    assert(&n1 == LIST_CONTAINER(&n1.next, Node, next));
+
+    LIST_FOR_EACH_SAFE(node, next, &l2) {
+        list_unlink(node);
+    }
+    assert(true == list_is_empty(&l2));
+    assert(NULL == list_rem_tail(&l2));
+
+    PrioList pl;
+    PrioNode p1;
+    PrioNode p2;
+    PrioNode p3;
+
+    plist_init(&pl);
+    p1.prio = 3;
+    p2.prio = 8;
+    p3.prio = 3;
+
+    assert(true == plist_is_empty(&pl));
+    assert(NULL == plist_get_head(&pl));
+
+    plist_add(&pl, &p1);
+    assert(false == plist_is_empty(&pl));
+    assert(&p1 == plist_get_head(&pl));
+    plist_add(&pl, &p2);
+    assert(&p2 == plist_get_head(&pl));
+    plist_add(&pl, &p3);
+    assert(&p2 == plist_get_head(&pl));
+
+    /* FIFO among equal priorities. */
+    plist_remove(&pl, &p2);
+    assert(&p1 == plist_get_head(&pl));
+    plist_remove(&pl, &p1);
+    assert(&p3 == plist_get_head(&pl));
+    plist_add(&pl, &p1);
+    assert(&p3 == plist_get_head(&pl));
+    plist_remove(&pl, &p3);
+    assert(&p1 == plist_get_head(&pl));
+    plist_remove(&pl, &p1);
+    assert(true == plist_is_empty(&pl));
+
     test_pass();
 }
 
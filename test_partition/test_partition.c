@@ -0,0 +1,119 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+#include <martos/martos.h>
+#include <test_common.h>
+
+/* The only window enables partition 1. Partition 2 is the
+background partition, which runs on the idle time of the
+window but never before an eligible task. */
+
+enum {WINDOW = 100};
+enum {STACK_SIZE = 1024};
+
+const PartitionWindow partition_schedule[] = {
+    {.length = WINDOW, .partitions = 1 << 1}
+};
+
+static Task tasks[4];
+static uint8_t stacks[4][STACK_SIZE];
+static Task *order[3];
+static int ran;
+static volatile int loops;
+
+static void record_f(void *user_data)
+{
+    order[ran] = task_find(NULL);
+    ran++;
+    while (1) {
+        signal_wait(SIGF_SINGLE);
+    }
+}
+
+static void delay_f(void *user_data)
+{
+    while (1) {
+        timer_delay(1);
+        loops++;
+    }
+}
+
+static void start(
+    Task *const task,
+    char *const name,
+    const Node_Prio prio,
+    const uint_fast8_t partition,
+    void (*const f)(void *user_data)
+)
+{
+    task_init(task, name, prio, f, NULL, stacks[task - tasks], STACK_SIZE);
+    task_set_partition(task, partition);
+    task_schedule(task);
+}
+
+/* With BG(10), SYS(5) and WIN(3) ready the eligible tasks run
+first, in priority order. */
+static void test_order(void)
+{
+    Task *const self = task_find(NULL);
+
+    task_set_prio(self, 20);
+    start(&tasks[0], "bg", 10, 2, record_f);
+    start(&tasks[1], "sys", 5, 0, record_f);
+    start(&tasks[2], "win", 3, 1, record_f);
+    timer_delay(2);
+    assert(3 == ran);
+    assert(&tasks[1] == order[0]);
+    assert(&tasks[2] == order[1]);
+    assert(&tasks[0] == order[2]);
+    task_set_prio(self, 0);
+}
+
+/* A background task which wakes while the init task idles
+shall preempt it at once, not at the next window. */
+static void test_donation(void)
+{
+    Ticks start_time;
+    int begin;
+
+    start(&tasks[3], "delay", 1, 2, delay_f);
+    begin = loops;
+    start_time = timer_get_clock();
+    timer_delay(3 * WINDOW);
+    assert(3 * WINDOW <= (Ticks) (timer_get_clock() - start_time));
+    assert(3 * WINDOW * 8 / 10 < loops - begin);
+}
+
+void test_task_f(void *user_data)
+{
+    test_order();
+    test_donation();
+
+    test_pass();
+}
@@ -0,0 +1,110 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+#include <martos/martos.h>
+#include <test_common.h>
+
+/* A periodic task runs jobs of given lengths. The test task has
+higher priority and holds the processor for JITTER ticks from
+the release of one job, which delays the start of that job. */
+
+enum {PERIOD = 20};
+enum {DEADLINE = 10};
+enum {JITTER = 3};
+enum {DELAYED_JOB = 3};
+enum {STACK_SIZE = 1024};
+
+/* Job 1 misses its deadline. Job 4 also overruns the period and
+job 5 is started at once to catch up. */
+static const Ticks work[] = {1, 14, 1, 1, 24, 1, 1};
+enum {JOBS = sizeof work / sizeof work[0]};
+
+static Task periodic_task;
+static uint8_t periodic_stack[STACK_SIZE];
+static Periodic periodic;
+static Semaphore done;
+
+static void spin_until(const Ticks tick)
+{
+    while ((int32_t) (timer_get_clock() - tick) < 0) {
+        ;
+    }
+}
+
+static void periodic_f(void *user_data)
+{
+    int i;
+
+    for (i = 0; i < JOBS; i++) {
+        spin_until(timer_get_clock() + work[i]);
+        task_wait_period();
+    }
+    sem_signal(&done);
+    while (1) {
+        signal_wait(SIGF_SINGLE);
+    }
+}
+
+void test_task_f(void *user_data)
+{
+    Task *const self = task_find(NULL);
+    Timer alarm;
+    Ticks first;
+
+    sem_init(&done, 0);
+    task_init(&periodic_task, "periodic", 1, periodic_f, NULL,
+      periodic_stack, STACK_SIZE);
+    assert(task_set_periodic(&periodic_task, &periodic, PERIOD,
+      DEADLINE, 0));
+    first = periodic.release;
+
+    timer_allocate(&alarm);
+    alarm.op = TIMER_ALARM;
+    alarm.tick = first + DELAYED_JOB * PERIOD;
+    timer_add(&alarm);
+    task_set_prio(self, 2);
+    task_schedule(&periodic_task);
+
+    signal_wait(alarm.signal);
+    spin_until(alarm.tick + JITTER);
+    timer_free(&alarm);
+    sem_wait(&done);
+
+    assert(JOBS == periodic.jobs);
+    assert(2 == periodic.deadline_misses);
+    assert(1 == periodic.overruns);
+    assert(first + JOBS * PERIOD == periodic.release);
+    /* The catch up job after the overrun started late too. */
+    assert(JITTER <= periodic.jitter_max && periodic.jitter_max < PERIOD);
+    assert(periodic.jitter_min < JITTER);
+    assert(work[4] <= periodic.response_max);
+    assert(periodic.response_min < DEADLINE);
+
+    test_pass();
+}
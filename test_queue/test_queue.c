@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <martos/martos.h>
+#include <test_common.h>
+
+/* A higher priority producer fills a small queue and is throttled
+until the test task has received the items. Items must arrive
+in order and intact, and the timed and non-blocking calls must
+give up on a full or empty queue. */
+
+enum {CAPACITY = 4};
+enum {ITEMS = 1000};
+enum {STACK_SIZE = 1024};
+
+typedef struct {
+    uint32_t seq;
+    uint32_t check;
+} Item;
+
+QUEUE_DECLARE(queue, Item, CAPACITY);
+
+static Task producer;
+static uint8_t producer_stack[STACK_SIZE];
+/* Most items in the queue seen by the producer. */
+static uint32_t fill_max;
+
+static void producer_f(void *user_data)
+{
+    Item item;
+    uint32_t i;
+
+    for (i = 0; i < ITEMS; i++) {
+        item.seq = i;
+        item.check = ~i;
+        queue_send(&queue, &item);
+        if (fill_max < queue.count) {
+            fill_max = queue.count;
+        }
+    }
+    while (1) {
+        signal_wait(SIGF_SINGLE);
+    }
+}
+
+void test_task_f(void *user_data)
+{
+    Item item;
+    Ticks start;
+    uint32_t i;
+
+    /* Empty. */
+    assert(false == queue_try_receive(&queue, &item));
+    start = timer_get_clock();
+    assert(false == queue_receive_timeout(&queue, &item, 10));
+    assert(10 <= (Ticks) (timer_get_clock() - start));
+
+    /* Full. */
+    item.seq = 0;
+    for (i = 0; i < CAPACITY; i++) {
+        assert(true == queue_try_send(&queue, &item));
+    }
+    assert(false == queue_try_send(&queue, &item));
+    assert(false == queue_send_timeout(&queue, &item, 10));
+    assert(plist_is_empty(&queue.senders));
+    for (i = 0; i < CAPACITY; i++) {
+        assert(true == queue_receive_timeout(&queue, &item, 10));
+    }
+    assert(0 == queue.count);
+
+    task_init(&producer, "producer", 1, producer_f, NULL,
+      producer_stack, STACK_SIZE);
+    task_schedule(&producer);
+    for (i = 0; i < ITEMS; i++) {
+        queue_receive(&queue, &item);
+        assert(i == item.seq && ~i == item.check);
+    }
+    assert(CAPACITY == fill_max);
+    assert(plist_is_empty(&queue.senders));
+    assert(plist_is_empty(&queue.receivers));
+
+    test_pass();
+}
@@ -0,0 +1,219 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include <martos/martos.h>
+#include <test_common.h>
+
+/* Reader tasks, one on each core but the first, check a table
+which a writer task rewrites every tick. The same work is done
+with a RwLock and with a binary Semaphore, and the read rates
+are compared. */
+
+#ifndef CPUS
+    #define CPUS 1
+#endif
+
+enum {READERS = 1 < CPUS ? CPUS - 1 : 2};
+enum {READS = 20000};
+enum {TABLE_SIZE = 256};
+enum {READER_PRIO = 1, WRITER_PRIO = 2};
+enum {STACK_SIZE = 1024};
+
+typedef struct {
+    Task task;
+    uint8_t stack[STACK_SIZE];
+    char name[8];
+    double seconds;
+} Reader;
+
+static Reader readers[READERS];
+static Task writer;
+static uint8_t writer_stack[STACK_SIZE];
+
+static uint32_t table[TABLE_SIZE];
+static RwLock lock;
+static Semaphore mutex;
+static bool use_rwlock;
+static volatile bool writing;
+static uint32_t writes;
+
+static Semaphore start;
+static Semaphore done;
+
+static double seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void read_lock(void)
+{
+    if (use_rwlock) {
+        rwlock_read_lock(&lock);
+    } else {
+        sem_wait(&mutex);
+    }
+}
+
+static void read_unlock(void)
+{
+    if (use_rwlock) {
+        rwlock_read_unlock(&lock);
+    } else {
+        sem_signal(&mutex);
+    }
+}
+
+static void reader_f(void *user_data)
+{
+    Reader *const reader = user_data;
+    double begin;
+    uint32_t first;
+    int i;
+    int j;
+
+    while (1) {
+        sem_wait(&start);
+        begin = seconds();
+        for (i = 0; i < READS; i++) {
+            read_lock();
+            first = table[0];
+            for (j = 1; j < TABLE_SIZE; j++) {
+                assert(first == table[j]);
+            }
+            read_unlock();
+        }
+        reader->seconds = seconds() - begin;
+        sem_signal(&done);
+    }
+}
+
+static void writer_f(void *user_data)
+{
+    int j;
+
+    while (1) {
+        timer_delay(1);
+        if (false == writing) {
+            continue;
+        }
+        if (use_rwlock) {
+            rwlock_write_lock(&lock);
+        } else {
+            sem_wait(&mutex);
+        }
+        writes++;
+        for (j = 0; j < TABLE_SIZE; j++) {
+            table[j] = writes;
+        }
+        if (use_rwlock) {
+            rwlock_write_unlock(&lock);
+        } else {
+            sem_signal(&mutex);
+        }
+    }
+}
+
+static double run(const bool rwlock)
+{
+    double rate;
+    int i;
+
+    use_rwlock = rwlock;
+    writing = true;
+    for (i = 0; i < READERS; i++) {
+        sem_signal(&start);
+    }
+    for (i = 0; i < READERS; i++) {
+        sem_wait(&done);
+    }
+    writing = false;
+    rate = 0;
+    for (i = 0; i < READERS; i++) {
+        rate += READS / readers[i].seconds;
+    }
+    return rate;
+}
+
+/* Single task checks of the lock states. */
+static void test_states(void)
+{
+    rwlock_read_lock(&lock);
+    rwlock_read_lock(&lock);
+    assert(2 == lock.count);
+    rwlock_read_unlock(&lock);
+    rwlock_read_unlock(&lock);
+    assert(0 == lock.count);
+    rwlock_write_lock(&lock);
+    assert(lock.writer && -RWLOCK_WRITER == lock.count);
+    rwlock_write_unlock(&lock);
+    assert(!lock.writer && 0 == lock.count);
+}
+
+void test_task_f(void *user_data)
+{
+    Reader *reader;
+    double rwlock_rate;
+    double sem_rate;
+    int i;
+
+    rwlock_init(&lock);
+    sem_init(&mutex, 1);
+    sem_init(&start, 0);
+    sem_init(&done, 0);
+    test_states();
+
+    for (i = 0; i < READERS; i++) {
+        reader = &readers[i];
+        snprintf(reader->name, sizeof reader->name, "reader%d", i);
+        task_init(&reader->task, reader->name, READER_PRIO, reader_f,
+          reader, reader->stack, STACK_SIZE);
+#if 1 < CPUS
+        task_set_affinity(&reader->task, (CpuSet) 1 << (1 + i));
+#endif
+        task_schedule(&reader->task);
+    }
+    task_init(&writer, "writer", WRITER_PRIO, writer_f, NULL,
+      writer_stack, STACK_SIZE);
+    task_schedule(&writer);
+
+    rwlock_rate = run(true);
+    sem_rate = run(false);
+    printf("%d readers: %10.0f reads/s with RwLock, %10.0f with Semaphore\n",
+      READERS, rwlock_rate, sem_rate);
+    printf("%u writes\n", (unsigned) writes);
+    assert(0 < writes);
+
+    test_pass();
+}
@@ -0,0 +1,193 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include <martos/martos.h>
+#include <test_common.h>
+
+/* One pair of communicating tasks pinned to each core does ROUNDS
+round trips with signals and then with messages, and the round
+trips per second are printed. All cores take the one kernel lock
+for each send and wait, so the pairs are serialized on it and the
+total does not tell how the kernel would scale. */
+
+#ifndef CPUS
+    #define CPUS 1
+#endif
+
+enum {ROUNDS = 20000};
+enum {PAIR_PRIO = 1};
+enum {PAIR_STACK_SIZE = 1024};
+/* Allocated by pong and ping respectively. */
+enum {SIG_PING = 1, SIG_PONG = 1};
+enum {SIGF_PING = 1 << SIG_PING, SIGF_PONG = 1 << SIG_PONG};
+
+typedef struct {
+    Task ping;
+    Task pong;
+    uint8_t ping_stack[PAIR_STACK_SIZE];
+    uint8_t pong_stack[PAIR_STACK_SIZE];
+    char ping_name[8];
+    char pong_name[8];
+    /* Owned by pong. */
+    MsgPort port;
+    /* Owned by ping. */
+    MsgPort reply;
+    Message message;
+    double signal_s;
+    double msgport_s;
+} Pair;
+
+static Pair pairs[CPUS];
+static Semaphore ready;
+static Semaphore done;
+
+static double seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void pong_f(void *user_data)
+{
+    Pair *const pair = user_data;
+    Message *msg;
+    int i;
+
+    assert(SIG_PING == signal_allocate(SIG_PING));
+    msgport_init(&pair->port);
+    sem_signal(&ready);
+
+    for (i = 0; i < ROUNDS; i++) {
+        signal_wait(SIGF_PING);
+        signal_send(&pair->ping, SIGF_PONG);
+    }
+    for (i = 0; i < ROUNDS; i++) {
+        msg = msgport_wait(&pair->port);
+        msgport_get(&pair->port);
+        msgport_reply(msg);
+    }
+    while (1) {
+        signal_wait(SIGF_PING);
+    }
+}
+
+static void ping_f(void *user_data)
+{
+    Pair *const pair = user_data;
+    double start;
+    int i;
+
+    assert(SIG_PONG == signal_allocate(SIG_PONG));
+    msgport_init(&pair->reply);
+    pair->message.reply_port = &pair->reply;
+
+    start = seconds();
+    for (i = 0; i < ROUNDS; i++) {
+        signal_send(&pair->pong, SIGF_PING);
+        signal_wait(SIGF_PONG);
+    }
+    pair->signal_s = seconds() - start;
+
+    start = seconds();
+    for (i = 0; i < ROUNDS; i++) {
+        msgport_send(&pair->port, &pair->message);
+        msgport_wait(&pair->reply);
+        msgport_get(&pair->reply);
+    }
+    pair->msgport_s = seconds() - start;
+
+    sem_signal(&done);
+    while (1) {
+        signal_wait(SIGF_PONG);
+    }
+}
+
+static void pair_start(
+    Task *const task,
+    char *const name,
+    void (*const f)(void *),
+    Pair *const pair,
+    uint8_t *const stack,
+    const int cpu
+)
+{
+    task_init(task, name, PAIR_PRIO, f, pair, stack, PAIR_STACK_SIZE);
+    task_set_affinity(task, (CpuSet) 1 << cpu);
+    task_schedule(task);
+}
+
+void test_task_f(void *user_data)
+{
+    Pair *pair;
+    double signal_rate;
+    double msgport_rate;
+    int cpu;
+
+    sem_init(&ready, 0);
+    sem_init(&done, 0);
+
+    /* The ports must exist before anything is sent to them. */
+    for (cpu = 0; cpu < CPUS; cpu++) {
+        pair = &pairs[cpu];
+        snprintf(pair->pong_name, sizeof pair->pong_name, "pong%d", cpu);
+        pair_start(&pair->pong, pair->pong_name, pong_f, pair,
+          pair->pong_stack, cpu);
+    }
+    for (cpu = 0; cpu < CPUS; cpu++) {
+        sem_wait(&ready);
+    }
+    for (cpu = 0; cpu < CPUS; cpu++) {
+        pair = &pairs[cpu];
+        snprintf(pair->ping_name, sizeof pair->ping_name, "ping%d", cpu);
+        pair_start(&pair->ping, pair->ping_name, ping_f, pair,
+          pair->ping_stack, cpu);
+    }
+    for (cpu = 0; cpu < CPUS; cpu++) {
+        sem_wait(&done);
+    }
+
+    signal_rate = 0;
+    msgport_rate = 0;
+    for (cpu = 0; cpu < CPUS; cpu++) {
+        pair = &pairs[cpu];
+        printf("core %d: %10.0f signal, %10.0f msgport round trips/s\n",
+          cpu, ROUNDS / pair->signal_s, ROUNDS / pair->msgport_s);
+        signal_rate += ROUNDS / pair->signal_s;
+        msgport_rate += ROUNDS / pair->msgport_s;
+    }
+    printf("total:  %10.0f signal, %10.0f msgport round trips/s\n",
+      signal_rate, msgport_rate);
+
+    test_pass();
+}
+
@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <martos/martos.h>
+#include <test_common.h>
+
+/* A producer writes one byte per tick, as a slow interrupt would,
+and the test task reads them TRIGGER bytes at a time in place.
+Spans must wrap around the end of the ring, the writer must stop
+on a full buffer and a timed wait must return what there is. */
+
+enum {SIZE = 16};
+enum {TRIGGER = 10};
+enum {BYTES = 100};
+enum {STACK_SIZE = 1024};
+
+static StreamBuffer stream;
+static uint8_t buffer[SIZE];
+static Task producer;
+static uint8_t producer_stack[STACK_SIZE];
+
+static void producer_f(void *user_data)
+{
+    uint8_t byte;
+
+    for (byte = 0; byte < BYTES; byte++) {
+        timer_delay(1);
+        assert(1 == stream_write(&stream, &byte, 1));
+    }
+    while (1) {
+        signal_wait(SIGF_SINGLE);
+    }
+}
+
+static void test_spans(void)
+{
+    static const uint8_t data[SIZE] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+    };
+    const uint8_t *span;
+    Ticks start;
+
+    assert(SIZE == stream_write(&stream, data, SIZE));
+    assert(0 == stream_write(&stream, data, 1));
+    assert(SIZE == stream_peek(&stream, &span));
+    assert(span == buffer);
+    stream_consume(&stream, 12);
+
+    /* Wraps around. */
+    assert(10 == stream_write(&stream, data, 10));
+    assert(14 == stream_available(&stream));
+    assert(4 == stream_peek(&stream, &span));
+    assert(12 == span[0] && 15 == span[3]);
+    stream_consume(&stream, 4);
+    assert(10 == stream_peek(&stream, &span));
+    assert(span == buffer && 0 == span[0] && 9 == span[9]);
+    stream_consume(&stream, 10);
+    assert(0 == stream_available(&stream));
+
+    start = timer_get_clock();
+    assert(0 == stream_wait_timeout(&stream, 1, 10));
+    assert(10 <= (Ticks) (timer_get_clock() - start));
+    assert(0 == stream.wanted);
+}
+
+void test_task_f(void *user_data)
+{
+    const uint8_t *span;
+    uint32_t count;
+    uint32_t i;
+    uint8_t expect;
+    int wakeups;
+
+    stream_init(&stream, buffer, SIZE);
+    test_spans();
+
+    task_init(&producer, "producer", 1, producer_f, NULL,
+      producer_stack, STACK_SIZE);
+    task_schedule(&producer);
+    expect = 0;
+    wakeups = 0;
+    while (expect < BYTES) {
+        assert(TRIGGER <= stream_wait(&stream, TRIGGER));
+        wakeups++;
+        while (0 != (count = stream_peek(&stream, &span))) {
+            for (i = 0; i < count; i++) {
+                assert(expect == span[i]);
+                expect++;
+            }
+            stream_consume(&stream, count);
+        }
+    }
+    assert(BYTES / TRIGGER == wakeups);
+
+    test_pass();
+}
@@ -0,0 +1,585 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <martos/martos.h>
+#include <test_common.h>
+
+/* Timer requests and the 64-bit clock around wrap-around of the
+tick count, and the cost of timer_add() and timer_abort() against
+the number of pending timers. The delays in the expiry test cross
+the levels of the timer wheel. */
+
+enum {DELAY_COUNT = 11};
+static const Ticks delays[DELAY_COUNT] = {
+    1, 2, 15, 16, 17, 255, 256, 257, 1000, 1500, 2100
+};
+/* Ticks a task may be late to observe an expiry. */
+enum {LATE_MAX = 100};
+
+/* More than TIMER_POLL_BUDGET timers expiring at the same tick. */
+enum {BURST_COUNT = 200};
+
+enum {BENCH_ROUNDS = 100000};
+enum {PENDING_MAX = 10000};
+static const int pending_counts[] = {0, 10, 100, 1000, PENDING_MAX};
+
+static Timer timers[DELAY_COUNT];
+static Timer many[PENDING_MAX];
+
+static double seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void test_expiry(void)
+{
+    Signals all;
+    Signals got;
+    Ticks start;
+    Ticks elapsed;
+    int i;
+
+    all = 0;
+    start = timer_get_clock();
+    for (i = 0; i < DELAY_COUNT; i++) {
+        timer_allocate(&timers[i]);
+        timers[i].op = TIMER_DELAY;
+        timers[i].delay = delays[i];
+        timer_add(&timers[i]);
+        assert(TIMER_ADDED == timers[i].status);
+        all |= timers[i].signal;
+    }
+
+    while (0 != all) {
+        got = signal_wait(all);
+        elapsed = timer_get_clock() - start;
+        for (i = 0; i < DELAY_COUNT; i++) {
+            if (0 != (got & timers[i].signal)) {
+                assert(TIMER_DONE == timers[i].status);
+                assert(delays[i] <= elapsed);
+                assert(elapsed <= delays[i] + LATE_MAX);
+            }
+        }
+        all &= ~got;
+    }
+
+    for (i = 0; i < DELAY_COUNT; i++) {
+        timer_free(&timers[i]);
+    }
+}
+
+static void test_abort(void)
+{
+    Task *const self = task_find(NULL);
+    Timer timer;
+
+    timer_allocate(&timer);
+    timer.op = TIMER_DELAY;
+    timer.delay = 50;
+    timer_add(&timer);
+    assert(TIMER_ADDED == timer.status);
+    timer_abort(&timer);
+    assert(TIMER_ABORTED == timer.status);
+    timer_delay(100);
+    assert(0 == (self->sig_recvd & timer.signal));
+
+    /* Already elapsed. */
+    timer.op = TIMER_ALARM;
+    timer.tick = timer_get_clock();
+    timer_add(&timer);
+    assert(TIMER_ABORTED == timer.status);
+    timer_free(&timer);
+    timer_delay(0);
+}
+
+static void test_burst(void)
+{
+    Timer timer;
+    int i;
+
+    timer_allocate(&timer);
+    timer.op = TIMER_ALARM;
+    timer.tick = timer_get_clock() + 20;
+    for (i = 0; i < BURST_COUNT; i++) {
+        many[i] = timer;
+        timer_add(&many[i]);
+        assert(TIMER_ADDED == many[i].status);
+    }
+    signal_wait(timer.signal);
+    /* The burst is spread over a few ticks. */
+    timer_delay(20);
+    for (i = 0; i < BURST_COUNT; i++) {
+        assert(TIMER_DONE == many[i].status);
+    }
+    timer_free(&timer);
+}
+
+static void test_periodic(void)
+{
+    enum {PERIOD = 10};
+    Timer timer;
+    Ticks first;
+    uint32_t expirations;
+    int i;
+
+    timer_allocate(&timer);
+    timer.op = TIMER_PERIODIC;
+    timer.period = PERIOD;
+    first = timer_get_clock() + PERIOD;
+    timer.tick = first;
+    timer_add(&timer);
+    assert(TIMER_ADDED == timer.status);
+
+    expirations = 0;
+    for (i = 0; i < 20; i++) {
+        expirations += timer_wait(&timer);
+        /* No drift. The timer may have expired again. */
+        assert(0 == (Ticks) (timer.tick - first) % PERIOD);
+        assert(expirations * PERIOD <= (Ticks) (timer.tick - first));
+        assert(timer_reached(timer.tick - PERIOD, timer_get_clock()));
+    }
+    assert(TIMER_ADDED == timer.status);
+
+    /* Miss a few periods. */
+    timer_delay(3 * PERIOD + PERIOD / 2);
+    expirations = timer_wait(&timer);
+    assert(3 <= expirations && expirations <= 4);
+    assert(expirations - 1 <= timer.overruns);
+
+    timer.missed = TIMER_SKIP;
+    timer_delay(3 * PERIOD + PERIOD / 2);
+    assert(1 == timer_wait(&timer));
+
+    timer_abort(&timer);
+    assert(TIMER_ABORTED == timer.status);
+    timer_free(&timer);
+}
+
+static void test_hrtimer(void)
+{
+    enum {HR_COUNT = 3};
+    static const uint32_t hr_delays[HR_COUNT] = {300000, 100000, 200000};
+    HrTimer timers[HR_COUNT];
+    HrTimerStats stats;
+    Signals all;
+    uint64_t start;
+    int i;
+
+    start = timer_get_ns();
+    all = 0;
+    for (i = 0; i < HR_COUNT; i++) {
+        hrtimer_allocate(&timers[i]);
+        timers[i].deadline = start + hr_delays[i];
+        hrtimer_add(&timers[i]);
+        assert(TIMER_ADDED == timers[i].status);
+        all |= timers[i].signal;
+    }
+    while (0 != all) {
+        all &= ~signal_wait(all);
+    }
+    for (i = 0; i < HR_COUNT; i++) {
+        assert(TIMER_DONE == timers[i].status);
+        hrtimer_free(&timers[i]);
+    }
+
+    hrtimer_allocate(&timers[0]);
+    timers[0].deadline = timer_get_ns() + 100000;
+    hrtimer_add(&timers[0]);
+    hrtimer_abort(&timers[0]);
+    assert(TIMER_ABORTED == timers[0].status);
+    hrtimer_free(&timers[0]);
+
+    for (i = 0; i < 200; i++) {
+        start = timer_get_ns();
+        hrtimer_delay(50000 + i * 750);
+        assert(50000 + i * 750 <= timer_get_ns() - start);
+    }
+
+    hrtimer_get_stats(&stats);
+    assert(HR_COUNT + 200 == stats.count);
+    printf("hrtimer latency: %u min, %u avg, %u max ns\n",
+      (unsigned) stats.latency_min,
+      (unsigned) (stats.latency_sum / stats.count),
+      (unsigned) stats.latency_max);
+}
+
+static Semaphore callback_sem;
+static uint32_t callback_count;
+static Task *callback_task;
+
+static void count_callback(Timer *const timer)
+{
+    callback_count++;
+    callback_task = task_find(NULL);
+}
+
+static void signal_callback(Timer *const timer)
+{
+    count_callback(timer);
+    sem_signal(timer->user_data);
+}
+
+static void busy_callback(Timer *const timer)
+{
+    uint64_t start = timer_get_ns();
+
+    count_callback(timer);
+    while (timer_get_ns() - start < 1000000) {
+    }
+}
+
+static void test_callback(void)
+{
+    TimerServiceStats before;
+    TimerServiceStats after;
+    Timer timer;
+    Ticks tick;
+    int i;
+
+    sem_init(&callback_sem, 0);
+    timer_init_callback(&timer, signal_callback, &callback_sem);
+    timer.op = TIMER_DELAY;
+    timer.delay = 5;
+    callback_count = 0;
+    timer_add(&timer);
+    sem_wait(&callback_sem);
+    assert(1 == callback_count);
+    assert(0 == strcmp("timers", callback_task->node.name));
+    assert(TIMER_DONE == timer.status);
+
+    /* Aborted before expiry. */
+    timer_add(&timer);
+    timer_abort(&timer);
+    timer_delay(10);
+    assert(1 == callback_count);
+
+    /* A batch: all expire at the same tick. */
+    timer_service_get_stats(&before);
+    tick = timer_get_clock() + 10;
+    callback_count = 0;
+    for (i = 0; i < 50; i++) {
+        timer_init_callback(&many[i], count_callback, NULL);
+        many[i].op = TIMER_ALARM;
+        many[i].tick = tick;
+        timer_add(&many[i]);
+    }
+    timer_delay(20);
+    timer_service_get_stats(&after);
+    assert(50 == callback_count);
+    assert(50 == after.callbacks - before.callbacks);
+    assert(1 == after.batches - before.batches);
+    assert(50 <= after.batch_max);
+
+    /* Periodic. */
+    timer_init_callback(&timer, count_callback, NULL);
+    timer.op = TIMER_PERIODIC;
+    timer.period = 5;
+    timer.tick = timer_get_clock() + 5;
+    callback_count = 0;
+    timer_add(&timer);
+    timer_delay(52);
+    timer_abort(&timer);
+    assert(9 <= callback_count && callback_count <= 11);
+
+    /* Busy callbacks exceed the execution-time limit. */
+    timer_service_get_stats(&before);
+    tick = timer_get_clock() + 5;
+    callback_count = 0;
+    for (i = 0; i < 5; i++) {
+        timer_init_callback(&many[i], busy_callback, NULL);
+        many[i].op = TIMER_ALARM;
+        many[i].tick = tick;
+        timer_add(&many[i]);
+    }
+    while (callback_count < 5) {
+        timer_delay(1);
+    }
+    timer_service_get_stats(&after);
+    assert(1 <= after.deferrals - before.deferrals);
+    assert(1000000 <= after.callback_max);
+}
+
+static MsgPort timeout_port;
+static Message timeout_message;
+
+static void send_callback(Timer *const timer)
+{
+    msgport_send(&timeout_port, &timeout_message);
+}
+
+/* Timed and non-blocking waits on the timeout of the task. */
+static void test_timeout(void)
+{
+    Task *const self = task_find(NULL);
+    Semaphore sem;
+    Timer timer;
+    Signals signal;
+    Ticks start;
+    Ticks elapsed;
+
+    signal = 1 << signal_allocate(-1);
+    assert(0 == signal_try_wait(signal));
+    signal_send(self, signal);
+    assert(signal == signal_try_wait(signal));
+    start = timer_get_clock();
+    assert(0 == signal_wait_timeout(signal, 20));
+    elapsed = timer_get_clock() - start;
+    assert(20 <= elapsed && elapsed <= 20 + LATE_MAX);
+    assert(TIMER_ADDED != self->timeout.status);
+    signal_send(self, signal);
+    assert(signal == signal_wait_timeout(signal, 20));
+    signal_free(signal);
+
+    /* Timed out requests leave the semaphore queue. */
+    sem_init(&sem, 0);
+    assert(false == sem_try_wait(&sem));
+    assert(false == sem_wait_timeout(&sem, 0));
+    assert(false == sem_wait_timeout(&sem, 10));
+    assert(0 == sem.count);
+    assert(plist_is_empty(&sem.req_queue));
+    assert(list_is_empty(&self->requests));
+    sem_signal(&sem);
+    assert(0 == (self->sig_recvd & SIGF_SINGLE));
+    assert(true == sem_try_wait(&sem));
+    assert(false == sem_try_wait(&sem));
+
+    /* Granted before the timeout. */
+    timer_init_callback(&timer, signal_callback, &sem);
+    timer.op = TIMER_DELAY;
+    timer.delay = 10;
+    timer_add(&timer);
+    start = timer_get_clock();
+    assert(true == sem_wait_timeout(&sem, 1000));
+    elapsed = timer_get_clock() - start;
+    assert(elapsed <= 10 + LATE_MAX);
+    assert(0 == sem.count);
+    assert(0 == (self->sig_recvd & SIGF_SINGLE));
+
+    msgport_init(&timeout_port);
+    assert(NULL == msgport_try_wait(&timeout_port));
+    assert(NULL == msgport_wait_timeout(&timeout_port, 10));
+    timer_init_callback(&timer, send_callback, NULL);
+    timer.op = TIMER_DELAY;
+    timer.delay = 10;
+    timer_add(&timer);
+    assert(&timeout_message == msgport_wait_timeout(&timeout_port, 1000));
+    assert(&timeout_message == msgport_try_wait(&timeout_port));
+    assert(&timeout_message == msgport_get(&timeout_port));
+    signal_free(timeout_port.signal);
+}
+
+/* Timeouts received as messages on one port. */
+static void test_message(void)
+{
+    enum {REQUEST_COUNT = 3};
+    static const Ticks request_delays[REQUEST_COUNT] = {30, 10, 20};
+    static TimerMessage requests[REQUEST_COUNT];
+    MsgPort port;
+    Message message;
+    TimerMessage *request;
+    int i;
+
+    msgport_init(&port);
+    for (i = 0; i < REQUEST_COUNT; i++) {
+        timer_init_message(&requests[i], &port);
+        requests[i].timer.op = TIMER_DELAY;
+        requests[i].timer.delay = request_delays[i];
+        timer_add(&requests[i].timer);
+    }
+    msgport_send(&port, &message);
+    assert(&message == msgport_wait(&port));
+    msgport_get(&port);
+
+    /* Replied in expiry order. */
+    for (i = 10; i <= 30; i += 10) {
+        request = (TimerMessage *) msgport_wait(&port);
+        msgport_get(&port);
+        assert(TIMER_DONE == request->timer.status);
+        assert((Ticks) i == request->timer.delay);
+    }
+    assert(NULL == msgport_get(&port));
+
+    /* Aborted and reused. */
+    timer_add(&requests[0].timer);
+    timer_abort(&requests[0].timer);
+    request = (TimerMessage *) msgport_get(&port);
+    assert(&requests[0] == request);
+    assert(TIMER_ABORTED == request->timer.status);
+    request->timer.delay = 5;
+    timer_add(&request->timer);
+    /* Not added again until the reply has been taken. */
+    assert(&request->message == msgport_wait(&port));
+    timer_add(&request->timer);
+    assert(TIMER_DONE == request->timer.status);
+    msgport_get(&port);
+    assert(NULL == msgport_get(&port));
+    timer_add(&request->timer);
+    assert(&request->message == msgport_wait(&port));
+    msgport_get(&port);
+    assert(TIMER_DONE == request->timer.status);
+    timer_abort(&request->timer);
+    assert(NULL == msgport_get(&port));
+
+    /* Alarm in the past. */
+    request->timer.op = TIMER_ALARM;
+    request->timer.tick = timer_get_clock();
+    timer_add(&request->timer);
+    assert(&request->message == msgport_get(&port));
+    assert(TIMER_ABORTED == request->timer.status);
+    signal_free(port.signal);
+}
+
+/* Requests with overlapping slack windows expire together. */
+static void test_slack(void)
+{
+    enum {SLACK_COUNT = 20};
+    Timer timer;
+    uint32_t saved;
+    Ticks start;
+    int i;
+
+    saved = timer_get_wakeups_saved();
+    timer_allocate(&timer);
+    timer.op = TIMER_DELAY;
+    timer.slack = 16;
+    start = timer_get_clock();
+    for (i = 0; i < SLACK_COUNT; i++) {
+        many[i] = timer;
+        many[i].delay = 20 + i;
+        timer_add(&many[i]);
+        assert(TIMER_ADDED == many[i].status);
+        assert(timer_reached(start + 20 + i, many[i].expires));
+        assert(timer_reached(many[i].expires, start + 20 + i + 16 + 1));
+    }
+    timer_delay(60);
+    for (i = 0; i < SLACK_COUNT; i++) {
+        assert(TIMER_DONE == many[i].status);
+    }
+    /* 20 ticks of deadlines with 16 ticks of slack fall on at most
+    three ticks. */
+    assert(SLACK_COUNT - 3 <= timer_get_wakeups_saved() - saved);
+    printf("slack: %u of %d wakeups saved\n",
+      (unsigned) (timer_get_wakeups_saved() - saved), SLACK_COUNT);
+    timer_free(&timer);
+}
+
+/* Run after the clock has wrapped around. */
+static void test_clock(void)
+{
+    uint64_t ticks;
+    uint64_t ns;
+    uint64_t last;
+    int i;
+
+    ticks = timer_get_clock64();
+    assert(1 == ticks >> 32);
+    assert((Ticks) ticks == timer_get_clock() ||
+      (Ticks) (ticks + 1) == timer_get_clock());
+    assert(timer_reached(timer_get_clock() - 1, timer_get_clock()));
+    assert(!timer_reached(timer_get_clock() + 10, timer_get_clock()));
+
+    last = timer_get_ns();
+    for (i = 0; i < 100000; i++) {
+        ns = timer_get_ns();
+        assert(last <= ns);
+        last = ns;
+    }
+    ticks = timer_get_clock64();
+    assert(ticks - 1 <= timer_ns_to_ticks(last));
+    assert(timer_ns_to_ticks(last) <= ticks + 1);
+
+    assert(0 == timer_ns_to_ticks(0));
+    assert(1 == timer_ns_to_ticks(1));
+    assert(1 == timer_ns_to_ticks(PLATFORM_TICK_NS));
+    assert(2 == timer_ns_to_ticks(PLATFORM_TICK_NS + 1));
+    assert(3 * PLATFORM_TICK_NS == timer_ticks_to_ns(3));
+    assert(5 == timer_us_to_ticks(timer_ticks_to_us(5)));
+}
+
+static void bench(void)
+{
+    Timer timer;
+    Timer probe;
+    double start;
+    double ns;
+    int pending;
+    size_t n;
+    int i;
+
+    timer_allocate(&timer);
+    timer.op = TIMER_DELAY;
+    probe = timer;
+
+    for (n = 0; n < sizeof pending_counts / sizeof pending_counts[0]; n++) {
+        pending = pending_counts[n];
+        for (i = 0; i < pending; i++) {
+            many[i] = timer;
+            many[i].delay = 100000 + (i * 7919) % 1000000;
+            timer_add(&many[i]);
+        }
+
+        start = seconds();
+        for (i = 0; i < BENCH_ROUNDS; i++) {
+            probe.delay = 100000 + (Ticks) i * 104729 % 1000000;
+            timer_add(&probe);
+            timer_abort(&probe);
+        }
+        ns = (seconds() - start) / BENCH_ROUNDS * 1e9;
+        printf("%5d pending: %6.0f ns per timer_add+timer_abort\n",
+          pending, ns);
+
+        for (i = 0; i < pending; i++) {
+            timer_abort(&many[i]);
+        }
+    }
+    timer_free(&timer);
+}
+
+void test_task_f(void *user_data)
+{
+    test_expiry();
+    test_abort();
+    test_burst();
+    test_periodic();
+    test_slack();
+    test_clock();
+    test_hrtimer();
+    test_callback();
+    test_timeout();
+    test_message();
+    bench();
+
+    test_pass();
+}
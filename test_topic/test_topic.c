@@ -0,0 +1,143 @@
+/*
+Copyright (c) 2014, Martin Åberg All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The names of the copyright holder(s) may not be used to endorse or
+   promote products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+#include <martos/martos.h>
+#include <test_common.h>
+
+/* Two subscriptions share a port with an ordinary message: one with
+a backlog deep enough for all samples and one with latest value
+only. Each sample shall be freed once, after the last reference to
+it is released. */
+
+enum {SAMPLES = 3};
+enum {DEPTH = 4};
+
+typedef struct {
+    Sample sample;
+    int value;
+    bool freed;
+} Reading;
+
+static Topic topic;
+static MsgPort port;
+static Subscription all;
+static Subscription latest;
+static Sample *backlog[DEPTH];
+static Reading readings[SAMPLES];
+static int frees;
+
+static void release(Sample *const sample)
+{
+    Reading *reading = (Reading *) sample;
+
+    assert(false == reading->freed);
+    reading->freed = true;
+    frees++;
+}
+
+void test_task_f(void *user_data)
+{
+    Message other;
+    Message *message;
+    Reading *reading;
+    bool got_other;
+    int received;
+    int i;
+
+    msgport_init(&port);
+    topic_init(&topic, release);
+
+    /* Without subscribers a sample is released at once. */
+    readings[0].value = 0;
+    topic_publish(&topic, &readings[0].sample);
+    assert(1 == frees);
+    readings[0].freed = false;
+    frees = 0;
+
+    topic_subscribe(&topic, &all, &port, backlog, DEPTH);
+    topic_subscribe(&topic, &latest, &port, NULL, 0);
+    other.reply_port = NULL;
+    msgport_send(&port, &other);
+    for (i = 0; i < SAMPLES; i++) {
+        readings[i].value = i;
+        topic_publish(&topic, &readings[i].sample);
+    }
+    /* Replaced samples are still held by the other subscription. */
+    assert(0 == frees);
+    assert(SAMPLES == all.count && 0 == all.dropped);
+    assert(1 == latest.count && SAMPLES - 1 == latest.dropped);
+
+    got_other = false;
+    received = 0;
+    while (NULL != (message = msgport_get(&port))) {
+        if (&other == message) {
+            got_other = true;
+        } else if (&all.message == message) {
+            while (NULL != (reading = (Reading *) topic_receive(&all))) {
+                assert(received == reading->value);
+                received++;
+                topic_release(&reading->sample);
+            }
+        } else {
+            assert(&latest.message == message);
+            reading = (Reading *) topic_receive(&latest);
+            assert(SAMPLES - 1 == reading->value);
+            assert(NULL == topic_receive(&latest));
+            topic_release(&reading->sample);
+        }
+    }
+    assert(got_other);
+    assert(SAMPLES == received);
+    assert(SAMPLES == frees);
+    assert(SAMPLES + 1 == (int) topic.published);
+
+    /* Notified again. Pending samples and queued messages go with
+    the subscription, which can then be made again. */
+    for (i = 0; i < SAMPLES; i++) {
+        readings[i].freed = false;
+    }
+    frees = 0;
+    topic_publish(&topic, &readings[0].sample);
+    topic_unsubscribe(&all);
+    topic_unsubscribe(&latest);
+    assert(1 == frees);
+    assert(NULL == msgport_get(&port));
+
+    topic_subscribe(&topic, &all, &port, backlog, DEPTH);
+    topic_publish(&topic, &readings[1].sample);
+    assert(&all.message == msgport_get(&port));
+    assert(NULL == msgport_get(&port));
+    reading = (Reading *) topic_receive(&all);
+    assert(&readings[1] == reading);
+    topic_release(&reading->sample);
+    assert(2 == frees);
+    topic_unsubscribe(&all);
+
+    test_pass();
+}